@@ -0,0 +1,73 @@
+/*
+  Common interface of the DAC chip classes, so that DACControl can drive a mix of chips through one collection.
+  Operations a chip does not support succeed without doing anything.
+*/
+
+#include <Wire.h>
+#include <SerialHelper.h>
+
+#ifndef DACChip_h
+#define DACChip_h
+#if ARDUINO >= 100
+  #include "Arduino.h"
+#else
+  #include "WProgram.h"
+  #include "pins_arduino.h"
+  #include "WConstants.h"
+#endif
+
+class DACChip
+{
+  public:
+    enum Source{Source_Serial, Source_SPDIF, Source_DSD};
+    struct FilterProfile                              // filter shape, IIR and DPLL bandwidths as register 7 and 12 bits, see ES9028::filterProfile()
+    {
+      byte reg7;
+      byte reg12;
+    };
+
+    struct Name                                       // DAC name, a pointer to a string that must outlive the DAC. Nothing is copied to the heap
+    {
+      Name(const char *val) : text(val), inFlash(false) {}
+      Name(const __FlashStringHelper *val) : text((const char *) val), inFlash(true) {} // e.g. a PROGMEM array cast to const __FlashStringHelper*
+      const char *text;
+      bool inFlash;
+    };
+
+    bool noI2C = false;                               // set to true for debugging/development of code when Arduino not connected via I2C to DAC
+
+    Name getName() { return _name; }
+    void printName(Msg::Level level = Msg::defaultLevel)
+    {
+      if (_name.inFlash)
+        Msg::print(level, (const __FlashStringHelper *) _name.text);
+      else
+        Msg::print(level, _name.text);
+    }
+    virtual bool getInitialised() = 0;
+    virtual bool reset() = 0;
+    virtual bool probe(byte &chipId) = 0;             // quietly checks the DAC answers before initialisation
+    virtual TwoWire* getWire() = 0;
+    virtual bool mute() = 0;
+    virtual bool unmute() = 0;
+    virtual bool readStatus(bool &lockStatus, bool &automuteStatus) = 0; // returns false on read error
+    virtual bool selectSource(DACChip::Source val) = 0;
+    virtual bool setMasterAttenuation(byte val) = 0;  // attenuation of the channels following the master volume, leaving the volume mode alone
+    virtual bool setChannelAttenuations(const byte vals[]) { return setMasterAttenuation(vals[0]); } // one value per channel, the first is used if the chip has no per channel volume
+    virtual bool isLeftChannel(byte channel) { return (channel & 1) == 0; }
+    virtual bool stageMasterAttenuation(byte val) { return setMasterAttenuation(val); } // writes the attenuation without applying it where the chip can latch it, see releaseVolume()
+    virtual bool stageChannelAttenuations(const byte vals[]) { return setChannelAttenuations(vals); }
+    virtual bool releaseVolume() { return true; }      // applies staged attenuations with a single write
+    virtual bool enableVolumeLatching() { return true; }
+    virtual bool setVolumeRate(byte) { return true; }
+    virtual bool setFineAttenuation(byte) { return true; }
+    virtual bool setFilterShape(byte) { return true; }
+    virtual bool applyFilterProfile(const FilterProfile &) { return true; }
+
+  protected:
+    DACChip(Name name) : _name(name) {}
+    ~DACChip() {}                                     // never deleted through the interface, so no virtual destructor
+    Name _name;
+};
+
+#endif
@@ -0,0 +1,94 @@
+#include "DACConfigStore.h"
+#include <EEPROM.h>
+
+void DACConfigStore::begin(unsigned int offset, byte slots)
+{
+  _offset = offset;
+  _slots = slots;
+  _enabled = true;
+#if defined(ESP8266) || defined(ESP32)
+  EEPROM.begin(_offset + (unsigned int) _slots * RecordSize);
+#endif
+}
+
+bool DACConfigStore::enabled()
+{
+  return _enabled;
+}
+
+bool DACConfigStore::load(byte slot, unsigned long profileHash, byte image[])
+{
+  if (!_enabled || (slot >= _slots))
+    return false;
+  unsigned int addr = _offset + (unsigned int) slot * RecordSize;
+  if (EEPROM.read(addr) != _magic)
+    return false;
+  if (_readLong(addr + 1) != profileHash)
+    return false;
+  unsigned long imageHash = _readLong(addr + 5);
+  for (byte i = 0; i < ES9028::ImageSize; i++)
+    image[i] = EEPROM.read(addr + 9 + i);
+  return hash(image, ES9028::ImageSize) == imageHash;
+}
+
+bool DACConfigStore::save(byte slot, unsigned long profileHash, const byte image[])
+{
+  if (!_enabled || (slot >= _slots))
+    return false;
+  unsigned int addr = _offset + (unsigned int) slot * RecordSize;
+  _update(addr, _magic);
+  _writeLong(addr + 1, profileHash);
+  _writeLong(addr + 5, hash(image, ES9028::ImageSize));
+  for (byte i = 0; i < ES9028::ImageSize; i++)
+    _update(addr + 9 + i, image[i]);
+  _commit();
+  return true;
+}
+
+void DACConfigStore::clear()
+{
+  if (!_enabled)
+    return;
+  for (byte slot = 0; slot < _slots; slot++)
+    _update(_offset + (unsigned int) slot * RecordSize, 0xFF);
+  _commit();
+}
+
+unsigned long DACConfigStore::hash(const byte data[], byte len, unsigned long seed)
+{
+  unsigned long h = seed;
+  for (byte i = 0; i < len; i++)
+  {
+    h ^= data[i];
+    h *= 16777619UL;
+  }
+  return h;
+}
+
+unsigned long DACConfigStore::_readLong(unsigned int addr)
+{
+  unsigned long val = 0;
+  for (byte i = 0; i < 4; i++)
+    val |= (unsigned long) EEPROM.read(addr + i) << (8 * i);
+  return val;
+}
+
+void DACConfigStore::_writeLong(unsigned int addr, unsigned long val)
+{
+  for (byte i = 0; i < 4; i++)
+    _update(addr + i, (byte) (val >> (8 * i)));
+}
+
+void DACConfigStore::_update(unsigned int addr, byte val)
+{
+  // avoid wearing the EEPROM (or dirtying the flash page) when the value has not changed
+  if (EEPROM.read(addr) != val)
+    EEPROM.write(addr, val);
+}
+
+void DACConfigStore::_commit()
+{
+#if defined(ESP8266) || defined(ESP32)
+  EEPROM.commit();
+#endif
+}
@@ -0,0 +1,41 @@
+/*
+  Persists the register image of each ES9028 DAC in EEPROM (or emulated EEPROM on the ESP8266/ESP32) so that
+  DACControl can restore the last known good configuration on power on instead of replaying the configuration callback
+*/
+
+#ifndef DACConfigStore_h
+#define DACConfigStore_h
+#if ARDUINO >= 100
+  #include "Arduino.h"
+#else
+  #include "WProgram.h"
+  #include "pins_arduino.h"
+  #include "WConstants.h"
+#endif
+#include <ES9028.h>
+
+class DACConfigStore
+{
+  public:
+    static const byte RecordSize = 1 + 4 + 4 + ES9028::ImageSize;  // magic, profile hash, image hash, image
+
+    void begin(unsigned int offset, byte slots);             // reserves slots records starting at offset
+    bool enabled();
+    bool load(byte slot, unsigned long profileHash, byte image[]);      // returns false if the slot is empty, corrupt or was produced by another profile
+    bool save(byte slot, unsigned long profileHash, const byte image[]); // only bytes that changed are written
+    void clear();
+    static unsigned long hash(const byte data[], byte len, unsigned long seed = 2166136261UL); // 32 bit FNV-1a
+
+  private:
+    static const byte _magic = 0xB5;
+    boolean _enabled = false;
+    unsigned int _offset = 0;
+    byte _slots = 0;
+
+    unsigned long _readLong(unsigned int addr);
+    void _writeLong(unsigned int addr, unsigned long val);
+    void _update(unsigned int addr, byte val);
+    void _commit();
+};
+
+#endif
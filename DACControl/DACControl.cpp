@@ -9,6 +9,7 @@
      _es9018dacCount = es9018dacCount;
      _es9028dacs = es9028dacs;
      _es9028dacCount = es9028dacCount;
+     _setChips();
    };
 #endif
 
@@ -16,6 +17,7 @@ DACControl::DACControl(ES9028 es9028dacs[], byte es9028dacCount)
 {
   _es9028dacs = es9028dacs;
   _es9028dacCount = es9028dacCount;
+  _setChips();
 };
 
 DACControl::DACControl(ES9028 es9028dacs[], byte es9028dacCount, int clockStretchLimit, byte addrI2C)
@@ -24,6 +26,18 @@ DACControl::DACControl(ES9028 es9028dacs[], byte es9028dacCount, int clockStretc
   _es9028dacCount = es9028dacCount;
   _clockStretchLimit = clockStretchLimit;
   _addrI2C = addrI2C;
+  _setChips();
+};
+
+void DACControl::_setChips()
+{
+  byte d = 0;
+  #ifdef USE_ES9018
+  for (byte i = 0; (i < _es9018dacCount) && (d < DACCONTROL_MAX_DACS); i++, d++)
+    _chips[d] = &_es9018dacs[i];
+  #endif
+  for (byte i = 0; (i < _es9028dacCount) && (d < DACCONTROL_MAX_DACS); i++, d++)
+    _chips[d] = &_es9028dacs[i];
 };
 
 #ifdef USE_ES9018
@@ -37,6 +51,53 @@ void DACControl::initES9028(ES9028Function val)
 {
   _initES9028 = val;
 }
+
+void DACControl::initES9028Steps(ES9028StepFunction val)
+{
+  _initES9028Steps = val;
+}
+
+void DACControl::setInitStepsPerLoop(byte val)
+{
+  _initStepsPerLoop = (val == 0) ? 1 : val;
+}
+
+DACControl::InitStage DACControl::getInitStage(byte dac)
+{
+  if ((dac >= _dacCount()) || (dac >= DACCONTROL_MAX_DACS))
+    return Init_Failed;
+  if (!_initStarted && !_initialised)
+    return Init_Pending;
+  return _initStage[dac];
+}
+
+bool DACControl::initialising()
+{
+  return _initStarted;
+}
+
+void DACControl::setStartupProbe(unsigned int minDelay, byte identicalReads, unsigned int maxDelay)
+{
+  _startupMinDelay = minDelay;
+  _startupReads = identicalReads;
+  _startupMaxDelay = (maxDelay < minDelay) ? minDelay : maxDelay;
+}
+
+unsigned long DACControl::getStartupTime()
+{
+  return _startupTime;
+}
+
+void DACControl::enableConfigCache(unsigned long profileId, unsigned int eepromOffset)
+{
+  _profileId = profileId;
+  _configStore.begin(eepromOffset, _es9028dacCount);
+}
+
+void DACControl::clearConfigCache()
+{
+  _configStore.clear();
+}
   
 void DACControl::onBeforePowerOff(EventFunction val)
 {
@@ -88,38 +149,55 @@ void DACControl::onAutomuteStatusChanged(EventFunction val)
   _onAutomuteStatusChanged = val;
 };
 
+void DACControl::onInputSwitched(EventFunction val)
+{
+  _onInputSwitched = val;
+};
+
 void DACControl::powerOn()
 {
-  if (!_power)
-  {
-    _eventBeforePowerOn();
-    _power = true;
-    Msg::println(F("Power On"));
-    if (_pinPowerRelay != 255)
-      digitalWrite(_pinPowerRelay, HIGH);
-    _eventAfterPowerOn();
-  }
+  if (_powerStep == Power_Off)
+    _startPowerOn();
+  else if (_powerStep >= Power_Mute)
+    _powerOnPending = true;  // power back on once the power down sequence has completed
 };
     
   void DACControl::powerOff()
   {
-    if (_power)
+    _powerOnPending = false;
+    if (_power && (_powerStep < Power_Mute))
     {
-      _eventBeforePowerOff();
-      if (_pinPowerRelay != 255)
-        digitalWrite(_pinPowerRelay, LOW);
-      _power = false;
-      Msg::println(F("Power Off"));
-      _eventAfterPowerOff();
+      Msg::println(F("Powering Off"));
+      _powerStart = millis();
+      _setPowerStep(Power_Mute);
+      bool wasInitialised = initialised();
+      mute();
+      _setPowerStep(Power_RampDown);
+      // the ramp only needs waiting for if the DACs were playing, the rest of the sequence runs in loop()
+      if (!wasInitialised)
+        _powerStepStart -= _powerRampDown;
     }
   };
+
+  void DACControl::setPowerDownTiming(unsigned int rampDown, unsigned int resetHold)
+  {
+    _powerRampDown = rampDown;
+    _powerResetHold = resetHold;
+  };
+
+  DACControl::PowerStep DACControl::getPowerStep()
+  {
+    return _powerStep;
+  };
+
+  unsigned long DACControl::getPowerTransitionTime()
+  {
+    return _powerTime;
+  };
     
   DACControl::Input DACControl::getInput()
   {
-    if (_inputSPDIF)
-      return SPDIF;
-    else
-      return I2S;
+    return _input;
   };
 
   bool DACControl::getPower()
@@ -130,7 +208,7 @@ void DACControl::powerOn()
   void DACControl::togglePower()
   {
     Msg::println(F("toggle power"));
-    if (_power)
+    if (_power && (_powerStep < Power_Mute))
     {
       powerOff();
     }
@@ -145,16 +223,9 @@ void DACControl::powerOn()
     if (initialised() && !_errorInitialising)
     {
       Msg::println(F("Mute"));
-      #ifdef USE_ES9018
-      for (int i = 0; i < _es9018dacCount; i++)
-      {
-        _es9018dacs[i].mute();
-      }
-      #endif
-      for (int i = 0; i < _es9028dacCount; i++)
-      {
-        _es9028dacs[i].mute();
-      }
+      _broadcast(Op_Mute);
+      _muted = true;
+      _events.raise(DACEvent::Event_Muted);
     }
   };
 
@@ -168,21 +239,22 @@ void DACControl::powerOn()
     return _initialised;
   }
   ;
+
+  bool DACControl::errorInitialising()
+  {
+    return _errorInitialising;
+  };
+
   void DACControl::unmute()
   {
     if (initialised() && !_errorInitialising)
     {
       Msg::println(F("Unmute"));
-      #ifdef USE_ES9018
-      for (int i = 0; i < _es9018dacCount; i++)
-      {
-        _es9018dacs[i].unmute();
-      }
-      #endif
-      for (int i=0; i < _es9028dacCount; i++)
-      {
-        _es9028dacs[i].unmute();
-      }
+      _muted = false;
+      _events.raise(DACEvent::Event_Unmuted);
+      // an input switch in progress unmutes once the DACs have locked
+      if (_switchStage == Switch_Idle)
+        _broadcast(Op_Unmute);
     }
   };
     
@@ -191,17 +263,7 @@ void DACControl::powerOn()
     if (getPower())
     {
       Msg::println(F("SPDIF Input"));
-      #ifdef USE_ES9018
-      for (int i = 0; i < _es9018dacCount; i++)
-      {
-        _es9018dacs[i].setInputSelect(ES9018::SPDIF);
-      }
-      #endif
-      for (int i=0; i < _es9028dacCount; i++)
-      {
-        _es9028dacs[i].setInputSelect(ES9028::InputSelect_SPDIF);
-      }
-      _inputSPDIF = true;
+      selectInput(SPDIF);
     }
   };
   
@@ -210,39 +272,73 @@ void DACControl::powerOn()
     if (getPower())
     {
       Msg::println(F("USB Input"));
-      #ifdef USE_ES9018
-      for (int i = 0; i < _es9018dacCount; i++)
-      {
-        _es9018dacs[i].setInputSelect(ES9018::I2SorDSD);
-      }
-      #endif
-      for (int i=0; i < _es9028dacCount; i++)
-      {
-        _es9028dacs[i].setInputSelect(ES9028::InputSelect_SERIAL);
-      }
-      _inputSPDIF = false;
+      selectInput(I2S);
     }
   };
+
+  void DACControl::setDSD()
+  {
+    if (getPower())
+    {
+      Msg::println(F("DSD Input"));
+      selectInput(DSD);
+    }
+  };
+
+  void DACControl::selectInput(DACControl::Input val)
+  {
+    if (!getPower())
+      return;
+    _input = val;
+    _inputSelected = true;
+    if (!initialised())
+      return;                   // selected by _eventInitialised() once every DAC has been through init
+    if (_errorInitialising)
+    {
+      // nothing is playing, so switch straight away
+      _broadcast(_selectOp(val));
+      refreshShadow();
+      return;
+    }
+    _switchStart = millis();
+    if (_switchStage == Switch_Idle)
+    {
+      _broadcast(Op_Mute);
+      _switchStageStart = millis();
+    }
+    // a switch already in progress has muted the DACs, so the new input is selected on the next loop()
+    _switchStage = Switch_Ramp;
+  };
+
+  void DACControl::setInputSwitchTiming(DACControl::Input input, unsigned int rampTime, unsigned int lockTimeout)
+  {
+    if (input >= _inputCount)
+      return;
+    _switchRampTime[input] = rampTime;
+    _switchLockTimeout[input] = lockTimeout;
+  };
+
+  bool DACControl::switchingInput()
+  {
+    return _switchStage != Switch_Idle;
+  };
+
+  unsigned long DACControl::getInputSwitchTime()
+  {
+    return _switchTime;
+  };
   
   void DACControl::setNoI2C()
   {
       Msg::println(Msg::W, F("Set No I2C"));
-      #ifdef USE_ES9018
-      for (int i = 0; i < _es9018dacCount; i++)
-      {
-        _es9018dacs[i].noI2C = true;
-      }
-      #endif
-      for (int i=0; i < _es9028dacCount; i++)
-      {
-        _es9028dacs[i].noI2C = true;
-      }
+      for (byte d = 0; (d < DACCONTROL_MAX_DACS) && (_chips[d] != NULL); d++)
+        _chips[d]->noI2C = true;
   };
   
   void DACControl::toggleInput()
   {
     Msg::println(F("toggle input"));
-    if (_inputSPDIF)
+    if (_input == SPDIF)
     {
       setUSB();
     }
@@ -254,37 +350,28 @@ void DACControl::powerOn()
   
   void DACControl::loop()
   {
-    if (_power)
+    if (_powerStep >= Power_Mute)
+      _powerDown();
+    else if (_power)
     {
       if (!initialised())
       {
-        if ((millis() - _lastPowerOnEvent) >= _initDelay)
+        if (_initStarted || _startupReady())
           _initDACs();
       }
       else if (_initSuccess())
       {
+      _applyVolume();
+      _switchInputs();
       if (millis() - _previousLockSampleMillis >= _lockSampleInterval)
       {
         _previousLockSampleMillis = millis();
-        bool automuted = (_es9028dacCount > 0);
-        bool b;
-        for (int i = 0; i < _es9028dacCount; i++)
-        {
-          if (_es9028dacs[i].getAutomuted(b))
-          {
-            if (!b)
-            {
-              // automuted is not true if any DAC is not automuted
-              automuted = false;
-            }
-          }  
-          else
-          {
-            // I2C error reading Automuted flag
-            Msg::print(Msg::E, F("Error reading Automute: "));
-            Msg::println(Msg::E, _es9028dacs[i].getName());
-          }
-        }
+        DACStatus status(_dacCount());
+        _readStatus(status);
+        _recordHistory(status);
+        _raiseStatusEvents(status);
+        // automuted is only true if every ES9028 DAC is automuted
+        bool automuted = (_es9028dacCount > 0) && (status.automuteBits().count() == _es9028dacCount);
         // Detect automute status change
         if (automuted != _automuted)
         {
@@ -292,17 +379,20 @@ void DACControl::powerOn()
            _eventAutomuteStatusChange();
         }
         // Detect lock status
-        int signalLock = locked();
-        if (signalLock != _prevSignalLock)
+        bool lockChanged = !_statusValid || (status.lockBits() != _status.lockBits()) || (status.readErrorBits() != _status.readErrorBits());
+        _status = status;
+        _statusValid = true;
+        _detectRate(status);
+        if (lockChanged)
         {
-          if (signalLock == _allLockedValue())
+          if (status.allLocked())
           {
             if (_onLock != NULL)
               _onLock();
           }
           else
           {
-            if (signalLock < 256)
+            if (!status.anyError())
             {
               if (_onNoLock != NULL)
                 _onNoLock();
@@ -314,108 +404,404 @@ void DACControl::powerOn()
                   _onLockReadError();
              }
             }
-            _prevSignalLock = signalLock;
-            #ifdef USE_ES9018
-            for (int i=0; i < _es9018dacCount; i++)
-            {
-               Msg::print(_es9018dacs[i].getName());
-               if (_es9018dacs[i].locked())
-                 Msg::println(F(" DAC locked"));
-               else
-                 Msg::println(F(" DAC not locked"));
-            }
-            #endif
-            for (int i=0; i < _es9028dacCount; i++)
+            for (byte d = 0; (d < DACCONTROL_MAX_DACS) && (_chips[d] != NULL); d++)
             {
-               Msg::print(_es9028dacs[i].getName());
-               if (_es9028dacs[i].locked())
+               _chips[d]->printName();
+               if (status.locked(d))
                  Msg::println(F(" DAC locked"));
                else
                  Msg::println(F(" DAC not locked"));
             }
           }
         }
+        _checkDrift();
       }
     }
+    _events.dispatch();
   };
   
   int DACControl::locked()
   {
+   DACStatus status(_dacCount());
+   _readStatus(status);
    int result = 0; 
-   int offset = 0;
-   bool readError;
-   #ifdef USE_ES9018
-   offset = _es9018dacCount;
-   for (int i=0; i < _es9018dacCount; i++)
+   for (byte i=0; (i < status.dacCount()) && (i < 8); i++)
    {
-      if (_es9018dacs[i].locked(readError))
+      if (status.locked(i))
         result += (1 << i);
-      else if (readError)
-      {
-        Msg::print(Msg::E, F("Error reading Lock: "));
-        Msg::println(Msg::E, _es9018dacs[i].getName());
+      else if (status.readError(i))
         result += (1 << (i + 8));
-      }
-   }
-   #endif
-   for (int i=0; i < _es9028dacCount; i++)
-   {
-      if (_es9028dacs[i].locked(readError))
-          result += (1 << (i + offset));
-      else if (readError)
-      {
-        Msg::print(Msg::E, F("Error reading Lock: "));
-        Msg::println(Msg::E, _es9028dacs[i].getName());
-        result += (1 << (i + offset + 8));
-      }
    }
    return result;
   };
 
+  const DACStatus& DACControl::getStatus()
+  {
+    return _status;
+  };
+
+  bool DACControl::allLocked()
+  {
+    return _status.allLocked();
+  };
+
+  bool DACControl::anyError()
+  {
+    return _status.anyError();
+  };
+
   void DACControl::setAttenuation(byte val)
   {
-    if (val > 124)
-    val = 124;
+    if (val > DACCONTROL_MAX_ATTENUATION)
+      val = DACCONTROL_MAX_ATTENUATION;
     Msg::print(F("Setting attenuation to: "));
     Msg::println(val);
-    #ifdef USE_ES9018
-    for (int i=0; i < _es9018dacCount; i++)
+    _attenuation = val;
+    _attenuationSet = true;
+    if (_synchronisedVolume)
+      setGroupAttenuation(val);
+    else
+      _broadcast(_channelVolumes ? Op_SetVolumes : Op_SetAttenuation, val);
+  };
+
+  bool DACControl::setGroupAttenuation(byte val)
+  {
+    if (val > DACCONTROL_MAX_ATTENUATION)
+      val = DACCONTROL_MAX_ATTENUATION;
+    _attenuation = val;
+    _attenuationSet = true;
+    // the ES9018 has no volume latch, so its attenuation is simply written during staging
+    _broadcast(Op_StageVolume, val);
+    byte dacCount = _dacCount();
+    if (dacCount > DACCONTROL_MAX_DACS)
+      dacCount = DACCONTROL_MAX_DACS;
+    bool ok = true;
+    bool first = true;
+    unsigned long firstRelease = 0;
+    unsigned long lastRelease = 0;
+    for (byte i = 0; i < dacCount; i++)
+    {
+      byte d = _busOrder[i];
+      if (!(_opResult[d] & Result_OK))
+      {
+        ok = false;
+        continue;
+      }
+      if (!_chips[d]->releaseVolume())
+        ok = false;
+      lastRelease = micros();
+      if (first)
+      {
+        firstRelease = lastRelease;
+        first = false;
+      }
+    }
+    _volumeSkew = lastRelease - firstRelease;
+    // outside the timing window, confirm every latch was re-enabled
+    _broadcast(Op_VerifyVolumeLatch);
+    for (byte d = 0; d < dacCount; d++)
+    {
+      if (!(_opResult[d] & Result_OK))
+        ok = false;
+    }
+    Msg::print(F("Group attenuation skew: "));
+    Msg::print(_volumeSkew);
+    Msg::println(F(" us"));
+    return ok;
+  };
+
+  unsigned long DACControl::getVolumeSkew()
+  {
+    return _volumeSkew;
+  };
+
+  void DACControl::setSynchronisedVolume(bool val)
+  {
+    _synchronisedVolume = val;
+  };
+
+  void DACControl::setFineAttenuation(unsigned int val)
+  {
+    if (val > DACCONTROL_MAX_ATTENUATION * 10)
+      val = DACCONTROL_MAX_ATTENUATION * 10;
+    byte fine = val % 10;
+    bool coarseChange = !_attenuationSet || (val / 10 != _attenuation);
+    // crossing a 0.5dB step moves the volume step and the trim in opposite directions. Whichever goes quieter is
+    // written first, so the level passes through a quieter point rather than jumping louder than either end
+    bool coarseFirst = coarseChange && _attenuationSet && (val > _attenuation * 10U + _fineAttenuation);
+    if (coarseFirst)
+      setAttenuation(val / 10);
+    if (!_fineAttenuationSet || (fine != _fineAttenuation))
+    {
+      _fineAttenuation = fine;
+      _fineAttenuationSet = true;
+      if (initialised() && _initSuccess())
+        _broadcast(Op_SetFineAttenuation);
+    }
+    if (coarseChange && !coarseFirst)
+      setAttenuation(val / 10);
+  };
+
+  bool DACControl::setFineTrim(byte dac, byte val)
+  {
+    if ((dac >= DACCONTROL_MAX_TRIM_DACS) || (val > 10))
+      return false;
+    _fineTrim[dac] = val;
+    _fineAttenuationSet = true;
+    if (initialised() && _initSuccess())
+      _broadcast(Op_SetFineAttenuation);
+    return true;
+  };
+
+  void DACControl::setBalance(int val)
+  {
+    if (val > 255)
+      val = 255;
+    else if (val < -255)
+      val = -255;
+    _balance = val;
+    _applyChannelVolumes();
+  };
+
+  bool DACControl::setChannelTrim(byte dac, byte channel, byte val)
+  {
+    if ((dac >= DACCONTROL_MAX_TRIM_DACS) || (channel >= ES9028::ChannelCount))
+      return false;
+    _channelTrim[dac][channel] = val;
+    _applyChannelVolumes();
+    return true;
+  };
+
+  bool DACControl::setChannelGroup(byte dac, byte channels, byte group)
+  {
+    if ((dac >= DACCONTROL_MAX_TRIM_DACS) || (group >= DACCONTROL_MAX_CHANNEL_GROUPS))
+      return false;
+    // a channel belongs to one group at most
+    for (byte g = 0; g < DACCONTROL_MAX_CHANNEL_GROUPS; g++)
+      _groupChannels[g][dac] &= ~channels;
+    _groupChannels[group][dac] |= channels;
+    _applyChannelVolumes();
+    return true;
+  };
+
+  bool DACControl::setGroupTrim(byte group, byte val)
+  {
+    if (group >= DACCONTROL_MAX_CHANNEL_GROUPS)
+      return false;
+    _groupTrim[group] = val;
+    _applyChannelVolumes();
+    return true;
+  };
+
+  void DACControl::_applyChannelVolumes()
+  {
+    _channelVolumes = true;
+    if (initialised() && _initSuccess())
+      setAttenuation(_attenuation);
+  };
+
+  void DACControl::_channelVolumesOf(byte d, DACChip &dac, byte vals[])
+  {
+    // master attenuation plus balance, group and channel trims, limited to the -127.5dB of the volume registers
+    for (byte ch = 0; ch < ES9028::ChannelCount; ch++)
     {
-        _es9018dacs[i].setAttenuation(val);
+      bool left = dac.isLeftChannel(ch);
+      long val = _attenuation;
+      if ((_balance > 0) && left)
+        val += _balance;
+      else if ((_balance < 0) && !left)
+        val -= _balance;
+      if (d < DACCONTROL_MAX_TRIM_DACS)
+      {
+        val += _channelTrim[d][ch];
+        for (byte g = 0; g < DACCONTROL_MAX_CHANNEL_GROUPS; g++)
+        {
+          if (_groupChannels[g][d] & (1 << ch))
+            val += _groupTrim[g];
+        }
+      }
+      vals[ch] = (val > 255) ? 255 : val;
     }
-    #endif
-    for (int i=0; i < _es9028dacCount; i++)
+  };
+
+  void DACControl::requestAttenuation(byte val)
+  {
+    if (_volumePending)
     {
-       _es9028dacs[i].setVolume1(val);
+      if (val == _volumeTarget)
+        return;
+      _volumeCoalesced++;
     }
+    else
+    {
+      if (_attenuationSet && (val == _attenuation))
+        return;
+      _volumeRequested = micros();
+      _volumePending = true;
+    }
+    _volumeTarget = val;
+  };
+
+  void DACControl::setVolumeRamp(byte val)
+  {
+    if (val > 7)
+      return;
+    _volumeRate = val;
+    if (initialised() && _initSuccess())
+      _broadcast(Op_SetVolumeRate, val);
+  };
+
+  unsigned long DACControl::getVolumeLatency()
+  {
+    return _volumeLatency;
+  };
+
+  unsigned long DACControl::getMaxVolumeLatency()
+  {
+    return _volumeLatencyMax;
+  };
+
+  unsigned long DACControl::getCoalescedVolumes()
+  {
+    return _volumeCoalesced;
+  };
+
+  bool DACControl::volumePending()
+  {
+    return _volumePending;
+  };
+
+  byte DACControl::getAttenuation()
+  {
+    return _attenuation;
+  };
+
+  void DACControl::_applyVolume()
+  {
+    // only the latest target is written, the hardware ramp smooths over the skipped steps
+    if (!_volumePending)
+      return;
+    _volumePending = false;
+    setAttenuation(_volumeTarget);
+    _volumeLatency = micros() - _volumeRequested;
+    if (_volumeLatency > _volumeLatencyMax)
+      _volumeLatencyMax = _volumeLatency;
   };
   
   void DACControl::setFilterShape(ES9028::FilterShape val)
   {
-    for (int i=0; i < _es9028dacCount; i++)
+    _filterShape = val;
+    _filterShapeSet = true;
+    if (!initialised())
+      return;                   // applied by _eventInitialised()
+    _broadcast(Op_SetFilterShape, val);
+    refreshShadow();
+  };
+
+  void DACControl::setRateProfile(DACControl::RateClass rate, ES9028::FilterShape filterShape, ES9028::IIR_Bandwidth iirBandwidth, ES9028::DpllBandwidth dpllSerial, ES9028::DpllBandwidth dpllDSD)
+  {
+    if (rate >= _rateClassCount)
+      return;
+    _rateProfiles[rate] = ES9028::filterProfile(filterShape, iirBandwidth, dpllSerial, dpllDSD);
+    _rateProfileSet |= (1 << rate);
+    // apply it at the next poll if the signal is already of this class
+    if (_rateClass == rate)
+      _rateClass = Rate_None;
+  };
+
+  void DACControl::clearRateProfiles()
+  {
+    _rateProfileSet = 0;
+  };
+
+  DACControl::RateClass DACControl::getRateClass()
+  {
+    return _rateClass;
+  };
+
+  unsigned long DACControl::getSampleRate()
+  {
+    return _sampleRate;
+  };
+
+  bool DACControl::subscribe(DACEventQueue::EventHandler handler)
+  {
+    return _events.subscribe(handler);
+  };
+
+  void DACControl::unsubscribe(DACEventQueue::EventHandler handler)
+  {
+    _events.unsubscribe(handler);
+  };
+
+  unsigned long DACControl::getDroppedEvents()
+  {
+    return _events.dropped();
+  };
+
+  void DACControl::recordHistory(DACHistory &history, unsigned int interval)
+  {
+    _history = &history;
+    _historyInterval = interval;
+  };
+
+  unsigned int DACControl::getI2CErrors(byte dac)
+  {
+    if (dac >= DACCONTROL_MAX_DACS)
+      return 0;
+    return _i2cErrors[dac];
+  };
+
+  void DACControl::onDACRecovered(RecoveryFunction val)
+  {
+    _onDACRecovered = val;
+  };
+
+  void DACControl::setDriftCheckInterval(unsigned int val)
+  {
+    _driftCheckInterval = val;
+  };
+
+  void DACControl::refreshShadow()
+  {
+    if (!initialised())
+      return;
+    for (byte i = 0; i < _es9028dacCount && i < DACCONTROL_MAX_DACS; i++)
     {
-      _es9028dacs[i].setFilterShape(val);
+      if (_es9028dacs[i].getInitialised())
+        _readSentinels(_es9028dacs[i], _sentinels[i]);
     }
   };
     
   void DACControl::setPinDACReset(byte val)
   {
-    _pinDACReset = val;
-    if (_pinDACReset != 255)
-    {
-      pinMode(_pinDACReset, OUTPUT);
-      pinMode(2, OUTPUT);
-    }
+    _pinDACResetCount = 0;
+    addPinDACReset(val);
   };
   
   void DACControl::setPinPowerRelay(byte val)
   {
-    _pinPowerRelay = val;
-    if (_pinPowerRelay != 255)
-    {
-      digitalWrite(_pinPowerRelay, LOW);
-      pinMode(_pinPowerRelay, OUTPUT);
-    }
+    _pinPowerRelayCount = 0;
+    addPinPowerRelay(val);
+  };
+
+  bool DACControl::addPinDACReset(byte val)
+  {
+    if ((val == 255) || (_pinDACResetCount >= DACCONTROL_MAX_POWER_PINS))
+      return false;
+    _pinDACReset[_pinDACResetCount++] = val;
+    pinMode(val, OUTPUT);
+    return true;
+  };
+
+  bool DACControl::addPinPowerRelay(byte val)
+  {
+    if ((val == 255) || (_pinPowerRelayCount >= DACCONTROL_MAX_POWER_PINS))
+      return false;
+    _pinPowerRelay[_pinPowerRelayCount++] = val;
+    digitalWrite(val, _power ? HIGH : LOW);
+    pinMode(val, OUTPUT);
+    return true;
   };
   
   void DACControl::setPinSDA(byte val)
@@ -427,30 +813,249 @@ void DACControl::powerOn()
   {
     _pinSCL = val;
   };
+
+  byte DACControl::getBusCount()
+  {
+    if (_busCount == 0)
+      _assignBuses();
+    return _busCount;
+  };
   
-int DACControl::_allLockedValue()
+byte DACControl::_dacCount()
 {
- int result = 0; 
- int offset = 0;
- #ifdef USE_ES9018
-   offset =_es9018dacCount;
-   for (int i=0; i < _es9018dacCount; i++)
-   {
-      result += (1 << i);
-   }
- #endif
- for (int i=0; i < _es9028dacCount; i++)
- {
-    result += (1 << (i + offset));
- }
- return result;
+  #ifdef USE_ES9018
+    return _es9018dacCount + _es9028dacCount;
+  #else
+    return _es9028dacCount;
+  #endif
+};
+
+void DACControl::_readStatus(DACStatus &status)
+{
+  // one status register read per DAC. ES9018 DACs are numbered first, followed by ES9028 DACs
+  _broadcast(Op_ReadStatus);
+  for (byte d = 0; d < status.dacCount(); d++)
+  {
+    status.setLocked(d, _opResult[d] & Result_Locked);
+    status.setAutomuted(d, _opResult[d] & Result_Automuted);
+    status.setReadError(d, !(_opResult[d] & Result_OK));
+  }
 };
+
+void DACControl::_assignBuses()
+{
+  // group the DACs by I2C bus and build an order that takes one DAC from each bus in turn
+  _busCount = 0;
+  byte dacCount = _dacCount();
+  if (dacCount > DACCONTROL_MAX_DACS)
+    dacCount = DACCONTROL_MAX_DACS;
+  for (byte d = 0; d < dacCount; d++)
+  {
+    TwoWire *wire = _chips[d]->getWire();
+    byte bus = 0;
+    while ((bus < _busCount) && (_buses[bus] != wire))
+      bus++;
+    if (bus == _busCount)
+    {
+      if (_busCount < DACCONTROL_MAX_BUSES)
+        _buses[_busCount++] = wire;
+      else
+      {
+        Msg::println(Msg::E, F("Too many I2C buses, increase DACCONTROL_MAX_BUSES"));
+        bus = 0;
+      }
+    }
+    _dacBus[d] = bus;
+  }
+  byte n = 0;
+  for (byte round = 0; n < dacCount; round++)
+  {
+    for (byte bus = 0; bus < _busCount; bus++)
+    {
+      byte found = 0;
+      for (byte d = 0; d < dacCount; d++)
+      {
+        if (_dacBus[d] == bus)
+        {
+          if (found == round)
+          {
+            _busOrder[n++] = d;
+            break;
+          }
+          found++;
+        }
+      }
+    }
+  }
+  if (_busCount > 1)
+  {
+    Msg::print(F("DACs spread across "));
+    Msg::print(_busCount);
+    Msg::println(F(" I2C buses"));
+  }
+};
+
+void DACControl::_broadcast(Operation op, byte arg)
+{
+  if (_busCount == 0)
+    _assignBuses();
+  byte dacCount = _dacCount();
+  if (dacCount > DACCONTROL_MAX_DACS)
+    dacCount = DACCONTROL_MAX_DACS;
+  _op = op;
+  _opArg = arg;
+  #if defined(ESP32)
+  if ((_busCount > 1) && (_busDone != NULL))
+  {
+    // each additional bus has its own task, the first bus is serviced by the caller
+    for (byte bus = 1; bus < _busCount; bus++)
+      xTaskNotifyGive(_busWorkers[bus].task);
+    _runBus(0);
+    for (byte bus = 1; bus < _busCount; bus++)
+      xSemaphoreTake(_busDone, portMAX_DELAY);
+    return;
+  }
+  #endif
+  for (byte i = 0; i < dacCount; i++)
+  {
+    byte d = _busOrder[i];
+    _opResult[d] = _apply(d, op, arg);
+  }
+};
+
+void DACControl::_runBus(byte bus)
+{
+  byte dacCount = _dacCount();
+  if (dacCount > DACCONTROL_MAX_DACS)
+    dacCount = DACCONTROL_MAX_DACS;
+  for (byte d = 0; d < dacCount; d++)
+  {
+    if (_dacBus[d] == bus)
+      _opResult[d] = _apply(d, _op, _opArg);
+  }
+};
+
+byte DACControl::_apply(byte d, Operation op, byte arg)
+{
+  DACChip &dac = *_chips[d];
+  bool ok = false;
+  bool lock, automute;
+  byte vals[ES9028::ChannelCount];
+  switch (op)
+  {
+    case Op_Mute:
+      ok = dac.mute();
+      break;
+    case Op_Unmute:
+      ok = dac.unmute();
+      break;
+    case Op_SetAttenuation:
+      ok = dac.setMasterAttenuation(arg);
+      break;
+    case Op_SetVolumes:
+      _channelVolumesOf(d, dac, vals);
+      ok = dac.setChannelAttenuations(vals);
+      break;
+    case Op_SetFineAttenuation:
+      ok = dac.setFineAttenuation(_fineAttenuation + ((d < DACCONTROL_MAX_TRIM_DACS) ? _fineTrim[d] : 0));
+      break;
+    case Op_SetFilterShape:
+      ok = dac.setFilterShape(arg);
+      break;
+    case Op_SelectSPDIF:
+      ok = dac.selectSource(DACChip::Source_SPDIF);
+      break;
+    case Op_SelectSerial:
+      ok = dac.selectSource(DACChip::Source_Serial);
+      break;
+    case Op_SelectDSD:
+      ok = dac.selectSource(DACChip::Source_DSD);
+      break;
+    case Op_StageVolume:
+      if (_channelVolumes)
+      {
+        _channelVolumesOf(d, dac, vals);
+        ok = dac.stageChannelAttenuations(vals);
+      }
+      else
+        ok = dac.stageMasterAttenuation(arg);
+      break;
+    case Op_VerifyVolumeLatch:
+      ok = dac.enableVolumeLatching();
+      break;
+    case Op_ApplyProfile:
+      ok = dac.applyFilterProfile(_rateProfiles[arg]);
+      break;
+    case Op_SetVolumeRate:
+      ok = dac.setVolumeRate(arg);
+      break;
+    case Op_ReadStatus:
+      if (dac.readStatus(lock, automute))
+        return Result_OK | (lock ? Result_Locked : 0) | (automute ? Result_Automuted : 0);
+      dac.printName(Msg::E);
+      Msg::println(Msg::E, F(": error reading Lock/Automute"));
+      return 0;
+  }
+  return ok ? Result_OK : 0;
+};
+
+#if defined(ESP32)
+void DACControl::_busTask(void *param)
+{
+  BusWorker *worker = (BusWorker*) param;
+  while (true)
+  {
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    worker->dacCtrl->_runBus(worker->bus);
+    xSemaphoreGive(worker->dacCtrl->_busDone);
+  }
+};
+
+void DACControl::_startBusTasks()
+{
+  if ((_busCount < 2) || (_busDone != NULL))
+    return;
+  _busDone = xSemaphoreCreateCounting(DACCONTROL_MAX_BUSES, 0);
+  for (byte bus = 1; bus < _busCount; bus++)
+  {
+    _busWorkers[bus].dacCtrl = this;
+    _busWorkers[bus].bus = bus;
+    xTaskCreate(_busTask, "DACBus", 4096, &_busWorkers[bus], uxTaskPriorityGet(NULL), &_busWorkers[bus].task);
+  }
+};
+#endif
     
 void DACControl::_eventInitialised()
 {
+  _powerTime = millis() - _powerStart;
+  _setPowerStep(Power_On);
+  DACEvent *event = _events.raise(DACEvent::Event_Initialised);
+  byte dacCount = _dacCount();
+  for (byte d = 0; (event != NULL) && (d < dacCount) && (d < DACCONTROL_MAX_DACS); d++)
+  {
+    if (_initStage[d] == Init_Done)
+      event->newMask.set(d, true);
+    else
+    {
+      DACEvent *error = _events.raise(DACEvent::Event_Error, d);
+      if (error != NULL)
+        error->detail = DACEvent::Error_InitFailed;
+    }
+  }
+  // apply the settings made while the DACs were still being initialised
+  if (_filterShapeSet)
+    _broadcast(Op_SetFilterShape, _filterShape);
+  if (_inputSelected)
+    _broadcast(_selectOp(_input));
+  if (_filterShapeSet || _inputSelected)
+    refreshShadow();
   if (_initSuccess())
   {
     Msg::println(F("Initialisation OK"));
+    if (_volumeRate != 255)
+      _broadcast(Op_SetVolumeRate, _volumeRate);
+    if (_fineAttenuationSet)
+      _broadcast(Op_SetFineAttenuation);
     if (_onInitialised != NULL)
       _onInitialised();
   }
@@ -470,21 +1075,79 @@ void DACControl::_eventAutomuteStatusChange()
     
 boolean DACControl::_initSuccess()
 {
-  #ifdef USE_ES9018
-     for (int i=0; i < _es9018dacCount; i++)
-     {
-        if (!_es9018dacs[i].getInitialised())
-          return false;
-     }
-  #endif
-  for (int i=0; i < _es9028dacCount; i++)
+  for (byte d = 0; (d < DACCONTROL_MAX_DACS) && (_chips[d] != NULL); d++)
   {
-     if (!_es9028dacs[i].getInitialised())
+     if (!_chips[d]->getInitialised())
        return false;
   }
   return true;
 };
 
+void DACControl::_startPowerOn()
+{
+  _eventBeforePowerOn();
+  _power = true;
+  Msg::println(F("Power On"));
+  _powerStart = millis();
+  _setPowerStep(Power_RelayOn);
+  _writePins(_pinPowerRelay, _pinPowerRelayCount, HIGH);
+  _eventAfterPowerOn();
+};
+
+void DACControl::_powerDown()
+{
+  // steps through the power down sequence without blocking, each step waits its configured time
+  unsigned long elapsed = millis() - _powerStepStart;
+  switch (_powerStep)
+  {
+    case Power_RampDown:
+      if (elapsed < _powerRampDown)
+        return;
+      _setPowerStep(Power_ResetAssert);
+      _disableDACs();
+      break;
+    case Power_ResetAssert:
+      if (elapsed < _powerResetHold)
+        return;
+      _eventBeforePowerOff();
+      _setPowerStep(Power_RelayOff);
+      _writePins(_pinPowerRelay, _pinPowerRelayCount, LOW, true);
+      _power = false;
+      Msg::println(F("Power Off"));
+      _eventAfterPowerOff();
+      _powerTime = millis() - _powerStart;
+      _setPowerStep(Power_Off);
+      if (_powerOnPending)
+      {
+        _powerOnPending = false;
+        _startPowerOn();
+      }
+      break;
+    default:
+      break;
+  }
+};
+
+void DACControl::_setPowerStep(PowerStep step)
+{
+  _powerStep = step;
+  _powerStepStart = millis();
+  Msg::print(Msg::D, F("Power step "));
+  Msg::println(Msg::D, (byte)step);
+  DACEvent *event = _events.raise(DACEvent::Event_PowerStep);
+  if (event != NULL)
+  {
+    event->value = _powerStepStart - _powerStart;
+    event->detail = step;
+  }
+};
+
+void DACControl::_writePins(const byte pins[], byte count, byte level, bool reverse)
+{
+  for (byte i = 0; i < count; i++)
+    digitalWrite(pins[reverse ? count - 1 - i : i], level);
+};
+
 void DACControl::_eventBeforePowerOn()
 {
   if (_onBeforePowerOn != NULL)
@@ -494,15 +1157,13 @@ void DACControl::_eventBeforePowerOn()
 void DACControl::_eventAfterPowerOn()
 {
   _lastPowerOnEvent = millis();
+  _events.raise(DACEvent::Event_PowerOn);
   if (_onAfterPowerOn != NULL)
     _onAfterPowerOn();
 };
     
 void DACControl::_eventBeforePowerOff()
 {
-   mute();
-   delay(10);
-  _disableDACs();
   if (_onBeforePowerOff != NULL)
     _onBeforePowerOff();
 };
@@ -510,20 +1171,26 @@ void DACControl::_eventBeforePowerOff()
     void DACControl::_eventAfterPowerOff()
     {
       Msg::println(Msg::W, F("Resetting..."));
-      #ifdef USE_ES9018
-      for (int i=0; i < _es9018dacCount; i++)
-      {
-         _es9018dacs[i].reset();
-      }
-      #endif
-      for (int i=0; i < _es9028dacCount; i++)
-      {
-         _es9028dacs[i].reset();
-      }
+      for (byte d = 0; (d < DACCONTROL_MAX_DACS) && (_chips[d] != NULL); d++)
+         _chips[d]->reset();
       _initialised = false;
-      _prevSignalLock = -1;
+      _initStarted = false;
+      _probing = false;
+      _statusValid = false;
+      _status.clear();
+      _muted = false;
+      _inputSelected = false;
+      _switchStage = Switch_Idle;
+      _rateClass = Rate_None;
+      _sampleRate = 0;
+      _signalType = ES9028::Signal_NONE;
+      memset(_i2cErrors, 0, sizeof(_i2cErrors));
+      _attenuationSet = false;
+      _volumeLatencyMax = 0;
+      _filterShapeSet = false;
       //TWCR = 0; // reset TwoWire Control Register to default, inactive state 
       //soft_restart(); //call reset
+      _events.raise(DACEvent::Event_PowerOff);
       if (_onAfterPowerOff != NULL)
         _onAfterPowerOff();
     };
@@ -531,15 +1198,13 @@ void DACControl::_eventBeforePowerOff()
     void DACControl::_disableDACs()
     {
       Msg::println(F("Pull DAC Reset Pin Low (disable)"));
-      digitalWrite(_pinDACReset, LOW);  // put dacs into reset
-      digitalWrite(2, LOW);  // put dacs into reset
+      _writePins(_pinDACReset, _pinDACResetCount, LOW);  // put dacs into reset
     };
     
     void DACControl::_enableDACs()
     {
       Msg::println(F("Pull DAC Reset Pin High (enable)"));
-      digitalWrite(_pinDACReset, HIGH);  // put dacs out of reset
-      digitalWrite(2, HIGH);  // put dacs out of reset
+      _writePins(_pinDACReset, _pinDACResetCount, HIGH);  // put dacs out of reset
     }
     
     void DACControl::begin()
@@ -558,7 +1223,7 @@ void DACControl::_eventBeforePowerOff()
         {
           Wire.begin(_pinSDA, _pinSCL, _addrI2C);
           Msg::print(F(" and slave at address "));
-          Msg::println(String(_addrI2C, HEX));
+          Msg::println(_addrI2C, HEX);
         }
       }
       else
@@ -573,7 +1238,7 @@ void DACControl::_eventBeforePowerOff()
         {
           Wire.begin(_addrI2C);
           Msg::print(F(" and slave at address "));
-          Msg::println(String(_addrI2C, HEX));
+          Msg::println(_addrI2C, HEX);
         }
       }
       if (_clockStretchLimit != -1)
@@ -582,92 +1247,604 @@ void DACControl::_eventBeforePowerOff()
         Wire.setClockStretchLimit(_clockStretchLimit);    // in µs
 #endif
       }
+      // DACs on buses other than Wire must have their bus begun by the sketch as the pins are board specific
+      _assignBuses();
+#if defined(ESP32)
+      _startBusTasks();
+#endif
     }
 
+    bool DACControl::_startupReady()
+    {
+      // poll each DAC's chip ID until it answers consistently, rather than waiting a fixed time for the regulators
+      unsigned long elapsed = millis() - _lastPowerOnEvent;
+      if (elapsed < _startupMinDelay)
+        return false;
+      byte dacCount = _dacCount();
+      if (dacCount > DACCONTROL_MAX_DACS)
+        dacCount = DACCONTROL_MAX_DACS;
+      if (!_probing)
+      {
+        _setPowerStep(Power_Probe);
+        _enableDACs();
+        for (byte d = 0; d < dacCount; d++)
+          _probeCount[d] = 0;
+        _probeInterval = _probeIntervalMin;
+        _lastProbe = millis() - _probeInterval;
+        _probing = true;
+      }
+      bool ready = false;
+      if (elapsed >= _startupMaxDelay)
+      {
+        if (_startupReads != 0)
+          Msg::println(Msg::W, F("Timed out waiting for DACs to answer"));
+        ready = true;
+      }
+      else if ((_startupReads != 0) && (millis() - _lastProbe >= _probeInterval))
+      {
+        _lastProbe = millis();
+        bool answering = true;
+        ready = true;
+        for (byte d = 0; d < dacCount; d++)
+        {
+          if (_probeCount[d] >= _startupReads)
+            continue;
+          byte id;
+          if (!_chips[d]->probe(id))
+          {
+            _probeCount[d] = 0;
+            answering = false;
+          }
+          else if ((_probeCount[d] > 0) && (id == _probeId[d]))
+            _probeCount[d]++;
+          else
+          {
+            _probeId[d] = id;
+            _probeCount[d] = 1;
+          }
+          if (_probeCount[d] < _startupReads)
+            ready = false;
+        }
+        // back off while the DACs are silent, poll quickly once they start answering
+        if (answering)
+          _probeInterval = _probeIntervalMin;
+        else if (_probeInterval < _probeIntervalMax)
+          _probeInterval *= 2;
+      }
+      if (ready)
+      {
+        _probing = false;
+        _startupTime = elapsed;
+        Msg::print(F("DACs ready after "));
+        Msg::print(_startupTime);
+        Msg::println(F(" milliseconds"));
+      }
+      return ready;
+    };
+
     void DACControl::_initDACs()
     {
-      Msg::println(F("Initialising DACs"));
-      _errorInitialising = false;
-      _enableDACs();
-      bool retry = true;
-      while (!_initSuccess() && retry)
+      byte dacCount = _dacCount();
+      if (dacCount > DACCONTROL_MAX_DACS)
+        dacCount = DACCONTROL_MAX_DACS;
+      if (!_initStarted)
       {
-       retry = false; // change to attempt multiple retries
-       // attempt to initialise uninitialised dacs
-       #ifdef USE_ES9018
-       for (int i=0; i < _es9018dacCount; i++)
+        Msg::println(F("Initialising DACs"));
+        _errorInitialising = false;
+        for (byte d = 0; d < dacCount; d++)
+          _initStage[d] = Init_Pending;
+        _initDAC = 0;
+        _configStep = 0;
+        _initStarted = true;
+        _setPowerStep(Power_Init);
+      }
+      // a bounded number of steps per call so that the rest of the sketch keeps running during startup
+      for (byte steps = 0; (steps < _initStepsPerLoop) && (_initDAC < dacCount); steps++)
+      {
+        if (_initStep(_initDAC))
+        {
+          _initDAC++;
+          _configStep = 0;
+        }
+      }
+      if (_initDAC < dacCount)
+        return;
+      _initStarted = false;
+      byte firstES9028 = _dacCount() - _es9028dacCount;
+      for (byte d = 0; (d < DACCONTROL_MAX_DACS) && (_chips[d] != NULL); d++)
+      {
+        if (!_chips[d]->getInitialised())
+        {
+          _initFail(*_chips[d]);
+          if (d >= firstES9028)
+            _errorInitialising = true;
+        }
+      }
+      _initialised = true;
+      _eventInitialised();
+    };
+
+    bool DACControl::_initStep(byte d)
+    {
+      // performs the next init stage of a DAC and returns true once it is done or has failed
+      InitStage &stage = _initStage[d];
+      #ifdef USE_ES9018
+      if (d < _es9018dacCount)
+      {
+        ES9018 &dac = _es9018dacs[d];
+        switch (stage)
         {
-           if (!_es9018dacs[i].getInitialised())
-           {
-            // try communicating with DAC
+          case Init_Pending:
+            if (dac.getInitialised())
+            {
+              stage = Init_Done;
+              break;
+            }
             Msg::print(F("Initialising ES8018 DAC at address "));
-            Msg::println(String(_es9018dacs[i].getAddress(), HEX));
-            if (_es9018dacs[i].initialise())
+            Msg::println(dac.getAddress(), HEX);
+            stage = dac.initialise() ? Init_Mute : Init_Failed;
+            break;
+          case Init_Mute:
+            dac.mute();
+            _initFound(dac.getAddress());
+            stage = Init_Configure;
+            break;
+          case Init_Configure:
+            stage = Init_Done;
+            if (_initES9018 == NULL)
+              Msg::println(Msg::W, F("no DAC initialisation specified"));
+            else
+              if (!_initES9018(&dac))
+              {
+                dac.reset();
+                stage = Init_Failed;
+              }
+            break;
+          default:
+            break;
+        }
+        return (stage == Init_Done) || (stage == Init_Failed);
+      }
+      byte slot = d - _es9018dacCount;
+      #else
+      byte slot = d;
+      #endif
+      ES9028 &dac = _es9028dacs[slot];
+      switch (stage)
+      {
+        case Init_Pending:
+          if (dac.getInitialised())
+          {
+            stage = Init_Done;
+            break;
+          }
+          Msg::print(F("Initialising ES9028 DAC at address "));
+          Msg::println(dac.getAddress(), HEX);
+          // try communicating with DAC
+          stage = dac.initialise() ? Init_Mute : Init_Failed;
+          break;
+        case Init_Mute:
+          dac.mute();
+          _initFound(dac.getAddress());
+          stage = Init_Restore;
+          break;
+        case Init_Restore:
+          // restore the last known good register image, falling back to the configuration callback
+          stage = Init_Configure;
+          if (_configStore.enabled())
+          {
+            byte image[ES9028::ImageSize];
+            if (_configStore.load(slot, _profileHash(dac), image))
             {
-              _es9018dacs[i].mute();
-              Msg::print(F("Found DAC at address "));
-              Msg::print(String(_es9018dacs[i].getAddress(), HEX));
-              Msg::print(F(" after "));
-              Msg::print(String(millis() - _lastPowerOnEvent));
-              Msg::println(F(" milliseconds"));
-              if (_initES9018 == NULL)
-                Msg::println(Msg::W, F("no DAC initialisation specified"));
+              if (dac.writeImage(image))
+              {
+                Msg::println(F("Restored cached DAC configuration"));
+                stage = Init_Unmute;
+              }
               else
-                if (!_initES9018(&_es9018dacs[i]))
-                  _es9018dacs[i].reset();
+                Msg::println(Msg::W, F("Cached DAC configuration did not verify"));
             }
           }
-        }
-        #endif
-        for (int i=0; i < _es9028dacCount; i++)
-        {
-          if (!_es9028dacs[i].getInitialised())
+          break;
+        case Init_Configure:
+          stage = Init_Unmute;
+          if (_initES9028Steps != NULL)
           {
-            Msg::print(F("Initialising ES9028 DAC at address "));
-            Msg::println(String(_es9028dacs[i].getAddress(), HEX));
-            // try communicating with DAC
-            if (_es9028dacs[i].initialise())
+            ConfigStep result = _initES9028Steps(&dac, _configStep++);
+            if (result == Config_Continue)
+              stage = Init_Configure;
+            else if (result == Config_Failed)
             {
-              _es9028dacs[i].mute();
-              Msg::print(F("Found DAC at address "));
-              Msg::print(String(_es9028dacs[i].getAddress(), HEX));
-              Msg::print(F(" after "));
-              Msg::print(String(millis() - _lastPowerOnEvent));
-              Msg::println(F(" milliseconds"));
-              if (_initES9028 == NULL)
-                Msg::println(Msg::W, F("no DAC initialisation specified"));
-              else
-                if (!_initES9028(&_es9028dacs[i]))
-                  _es9028dacs[i].reset();
-              _es9028dacs[i].unmute();
+              dac.reset();
+              stage = Init_Failed;
+            }
+          }
+          else if (_initES9028 == NULL)
+            Msg::println(Msg::W, F("no DAC initialisation specified"));
+          else
+            if (!_initES9028(&dac))
+            {
+              dac.reset();
+              stage = Init_Failed;
             }
+          if (stage == Init_Unmute)
+            _saveConfig(slot, dac);
+          break;
+        case Init_Unmute:
+          dac.unmute();
+          _readSentinels(dac, _sentinels[slot]);
+          stage = Init_Done;
+          break;
+        default:
+          break;
+      }
+      return (stage == Init_Done) || (stage == Init_Failed);
+    };
+
+    unsigned long DACControl::_profileHash(ES9028 &dac)
+    {
+      // the image is only valid for the same profile, DAC address, mode and chip
+      byte key[7];
+      key[0] = _profileId;
+      key[1] = _profileId >> 8;
+      key[2] = _profileId >> 16;
+      key[3] = _profileId >> 24;
+      key[4] = dac.getAddress();
+      key[5] = dac.getMode();
+      key[6] = dac.chipType();
+      return DACConfigStore::hash(key, sizeof(key));
+    };
+
+    void DACControl::_saveConfig(byte slot, ES9028 &dac)
+    {
+      if (!_configStore.enabled())
+        return;
+      byte image[ES9028::ImageSize];
+      if (dac.readImage(image))
+        _configStore.save(slot, _profileHash(dac), image);
+    };
+
+    DACControl::Operation DACControl::_selectOp(Input val)
+    {
+      switch (val)
+      {
+        case SPDIF:
+          return Op_SelectSPDIF;
+        case DSD:
+          return Op_SelectDSD;
+        default:
+          return Op_SelectSerial;
+      }
+    };
+
+    void DACControl::_switchInputs()
+    {
+      switch (_switchStage)
+      {
+        case Switch_Ramp:
+          // wait for the mute ramp to reach silence before touching the inputs
+          if (millis() - _switchStageStart < _switchRampTime[_input])
+            return;
+          _broadcast(_selectOp(_input));
+          refreshShadow();
+          _switchStage = Switch_Lock;
+          _switchStageStart = millis();
+          _lastSwitchPoll = millis();
+          break;
+        case Switch_Lock:
+        {
+          if (millis() - _lastSwitchPoll < _switchPollInterval)
+            return;
+          _lastSwitchPoll = millis();
+          DACStatus status(_dacCount());
+          _readStatus(status);
+          if (!status.allLocked())
+          {
+            if (millis() - _switchStageStart < _switchLockTimeout[_input])
+              return;
+            Msg::println(Msg::W, F("DACs did not lock onto the new input"));
+            DACEvent *event = _events.raise(DACEvent::Event_Error);
+            if (event != NULL)
+              event->detail = DACEvent::Error_NoLock;
+          }
+          if (!_muted)
+            _broadcast(Op_Unmute);
+          _switchStage = Switch_Idle;
+          _switchTime = millis() - _switchStart;
+          Msg::print(F("Input switched in "));
+          Msg::print(_switchTime);
+          Msg::println(F(" milliseconds"));
+          DACEvent *event = _events.raise(DACEvent::Event_InputSwitched);
+          if (event != NULL)
+          {
+            event->value = _switchTime;
+            event->detail = _input;
+          }
+          if (_onInputSwitched != NULL)
+            _onInputSwitched();
+          break;
+        }
+        default:
+          break;
+      }
+    };
+
+    DACControl::RateClass DACControl::_classifyRate(ES9028::SignalType type, unsigned long sampleRate)
+    {
+      switch (type)
+      {
+        case ES9028::Signal_DSD:
+          return Rate_DSD;
+        case ES9028::Signal_DoP:
+          return Rate_DoP;
+        case ES9028::Signal_NONE:
+          return Rate_None;
+        default:
+          if (sampleRate <= 50000)
+            return Rate_PCM48k;
+          if (sampleRate <= 100000)
+            return Rate_PCM96k;
+          return Rate_PCM192k;
+      }
+    };
+
+    void DACControl::_detectRate(const DACStatus &status)
+    {
+      if (((_rateProfileSet == 0) && !_events.subscribed()) || (_switchStage != Switch_Idle))
+        return;
+      // every DAC is fed the same stream, so only the first locked ES9028 is read
+      #ifdef USE_ES9018
+      byte d = _es9018dacCount;
+      #else
+      byte d = 0;
+      #endif
+      for (byte i = 0; i < _es9028dacCount; i++, d++)
+      {
+        if (!status.locked(d))
+          continue;
+        ES9028::SignalType type;
+        unsigned long sampleRate;
+        if (!_es9028dacs[i].readSignal(type, sampleRate))
+          return;
+        RateClass rateClass = _classifyRate(type, sampleRate);
+        if (rateClass == Rate_None)
+          return;
+        // rates that did not snap to a standard rate wander a little from poll to poll
+        unsigned long diff = (sampleRate > _sampleRate) ? sampleRate - _sampleRate : _sampleRate - sampleRate;
+        if ((type != _signalType) || (diff > _sampleRate / 200))
+        {
+          _sampleRate = sampleRate;
+          _signalType = type;
+          Msg::print(F("Sample rate changed to "));
+          Msg::print(sampleRate);
+          Msg::println(F(" Hz"));
+          DACEvent *event = _events.raise(DACEvent::Event_RateChanged, d);
+          if (event != NULL)
+          {
+            event->value = sampleRate;
+            event->detail = type;
           }
         }
+        if (rateClass == _rateClass)
+          return;
+        _rateClass = rateClass;
+        // classes without a profile keep the current settings
+        if (_rateProfileSet & (1 << rateClass))
+        {
+          if (!_muted)
+            _broadcast(Op_Mute);
+          _broadcast(Op_ApplyProfile, rateClass);
+          if (!_muted)
+            _broadcast(Op_Unmute);
+        }
+        return;
       }
-     #ifdef USE_ES9018
-     for (int i=0; i < _es9018dacCount; i++)
-     {
-        if (!_es9018dacs[i].getInitialised())
-          _initFail(_es9018dacs[i].getName());
-     }
-     #endif
-     for (int i=0; i < _es9028dacCount; i++)
-     {
-        if (!_es9028dacs[i].getInitialised())
+    };
+
+    void DACControl::_raiseStatusEvents(const DACStatus &status)
+    {
+      if (!_events.subscribed())
+        return;
+      // _status still holds the previous poll (all clear before the first one)
+      if (!_statusValid || (status.lockBits() != _status.lockBits()))
+      {
+        DACEvent *event = _events.raise(DACEvent::Event_LockChanged);
+        if (event != NULL)
         {
-          _initFail(_es9028dacs[i].getName());
-          _errorInitialising = true;
+          event->oldMask = _status.lockBits();
+          event->newMask = status.lockBits();
         }
       }
-      _initialised = true;
-      _eventInitialised();
+      if (status.automuteBits() != _status.automuteBits())
+      {
+        DACEvent *event = _events.raise(DACEvent::Event_AutomuteChanged);
+        if (event != NULL)
+        {
+          event->oldMask = _status.automuteBits();
+          event->newMask = status.automuteBits();
+        }
+      }
+      for (byte d = 0; d < status.dacCount(); d++)
+      {
+        if (status.readError(d) && !_status.readError(d))
+        {
+          DACEvent *event = _events.raise(DACEvent::Event_Error, d);
+          if (event != NULL)
+            event->detail = DACEvent::Error_Read;
+        }
+      }
+    };
+
+    void DACControl::_recordHistory(const DACStatus &status)
+    {
+      byte dacCount = status.dacCount();
+      for (byte d = 0; d < dacCount; d++)
+      {
+        if (status.readError(d) && (_i2cErrors[d] < 65535))
+          _i2cErrors[d]++;
+      }
+      if (_history == NULL)
+        return;
+      // a sample every interval, and straight away when any DAC's flags change so short dropouts are not missed
+      bool changed = !_statusValid || (status.lockBits() != _status.lockBits()) || (status.automuteBits() != _status.automuteBits()) || (status.readErrorBits() != _status.readErrorBits());
+      if (!changed && (millis() - _previousHistoryMillis < _historyInterval))
+        return;
+      _previousHistoryMillis = millis();
+      DACHistory::Sample sample;
+      sample.time = millis();
+      for (byte d = 0; d < dacCount; d++)
+      {
+        sample.dac = d;
+        sample.flags = 0;
+        if (status.locked(d))
+          sample.flags |= DACHistory::Flag_Locked;
+        if (status.automuted(d))
+          sample.flags |= DACHistory::Flag_Automuted;
+        if (status.readError(d))
+          sample.flags |= DACHistory::Flag_ReadError;
+        sample.signalType = ES9028::Signal_NONE;
+        sample.sampleRate = 0;
+        sample.i2cErrors = _i2cErrors[d];
+        // the signal is only read from locked ES9028 DACs
+        #ifdef USE_ES9018
+        bool es9028 = (d >= _es9018dacCount);
+        byte slot = d - _es9018dacCount;
+        #else
+        bool es9028 = true;
+        byte slot = d;
+        #endif
+        if (es9028 && status.locked(d))
+        {
+          ES9028::SignalType type;
+          if (_es9028dacs[slot].readSignal(type, sample.sampleRate))
+            sample.signalType = type;
+        }
+        _history->add(sample);
+      }
+    };
+
+    // registers a silent reset (brownout, ESD) would return to their power on defaults
+    const byte DACControl::_sentinelRegs[DACControl::_sentinelCount] = {1, 2, 15, 38};
+    // the volume mode bit of register 15 follows balance and trims (Op_SetVolumes), so it is left out of the comparison
+    const byte DACControl::_sentinelMasks[DACControl::_sentinelCount] = {0xFF, 0xFF, 0xFD, 0xFF};
+
+    bool DACControl::_readSentinels(ES9028 &dac, byte vals[])
+    {
+      for (byte i = 0; i < _sentinelCount; i++)
+      {
+        if (!dac.readRegisters(_sentinelRegs[i], &vals[i], 1))
+          return false;
+        vals[i] &= _sentinelMasks[i];
+      }
+      return true;
+    };
+
+    void DACControl::_checkDrift()
+    {
+      if ((_driftCheckInterval == 0) || (_es9028dacCount == 0))
+        return;
+      if (millis() - _previousDriftCheckMillis < _driftCheckInterval)
+        return;
+      _previousDriftCheckMillis = millis();
+      // one DAC per interval keeps the I2C traffic per loop() bounded
+      if (_driftCheckDAC >= _es9028dacCount || _driftCheckDAC >= DACCONTROL_MAX_DACS)
+        _driftCheckDAC = 0;
+      byte slot = _driftCheckDAC++;
+      ES9028 &dac = _es9028dacs[slot];
+      if (!dac.getInitialised())
+        return;
+      byte vals[_sentinelCount];
+      if (!_readSentinels(dac, vals))
+        return;                                 // read errors are reported by the status poll
+      if (memcmp(vals, _sentinels[slot], _sentinelCount) != 0)
+        _recoverDAC(slot);
+    };
+
+    void DACControl::_recoverDAC(byte slot)
+    {
+      ES9028 &dac = _es9028dacs[slot];
+      #ifdef USE_ES9018
+      byte d = slot + _es9018dacCount;
+      #else
+      byte d = slot;
+      #endif
+      unsigned long start = millis();
+      dac.printName(Msg::W);
+      Msg::println(Msg::W, F(" DAC registers changed unexpectedly, reconfiguring"));
+      dac.mute();
+      bool ok = false;
+      if (_configStore.enabled())
+      {
+        byte image[ES9028::ImageSize];
+        if (_configStore.load(slot, _profileHash(dac), image))
+          ok = dac.writeImage(image);
+      }
+      if (!ok)
+      {
+        // as in init, the mode's channel mapping comes before the configuration callback, which expects it in place.
+        // The verified register writes skip registers that still hold the configured value
+        ok = dac.setMode(dac.getMode());
+        if (ok && (_initES9028Steps != NULL))
+        {
+          ConfigStep result = Config_Continue;
+          for (byte step = 0; result == Config_Continue; step++)
+            result = _initES9028Steps(&dac, step);
+          ok = (result == Config_Done);
+        }
+        else if (ok && (_initES9028 != NULL))
+          ok = _initES9028(&dac);
+      }
+      if (!ok)
+      {
+        dac.printName(Msg::E);
+        Msg::println(Msg::E, F(" DAC could not be reconfigured"));
+        DACEvent *event = _events.raise(DACEvent::Event_Error, d);
+        if (event != NULL)
+          event->detail = DACEvent::Error_RecoveryFailed;
+        return;
+      }
+      // reapply the settings made through DACControl since initialisation
+      if (_filterShapeSet)
+        _apply(d, Op_SetFilterShape, _filterShape);
+      if ((_rateClass != Rate_None) && (_rateProfileSet & (1 << _rateClass)))
+        _apply(d, Op_ApplyProfile, _rateClass);
+      if (_inputSelected)
+        _apply(d, _selectOp(_input), 0);
+      if (_volumeRate != 255)
+        _apply(d, Op_SetVolumeRate, _volumeRate);
+      if (_fineAttenuationSet)
+        _apply(d, Op_SetFineAttenuation, 0);
+      if (_attenuationSet)
+        _apply(d, _channelVolumes ? Op_SetVolumes : Op_SetAttenuation, _attenuation);
+      if (!_muted)
+        dac.unmute();
+      _readSentinels(dac, _sentinels[slot]);
+      unsigned long recoveryTime = millis() - start;
+      dac.printName(Msg::W);
+      Msg::print(Msg::W, F(" DAC recovered in "));
+      Msg::print(Msg::W, recoveryTime);
+      Msg::println(Msg::W, F(" milliseconds"));
+      DACEvent *event = _events.raise(DACEvent::Event_Recovered, d);
+      if (event != NULL)
+        event->value = recoveryTime;
+      if (_onDACRecovered != NULL)
+        _onDACRecovered(d, recoveryTime);
+    };
+
+    void DACControl::_initFound(byte address)
+    {
+      Msg::print(F("Found DAC at address "));
+      Msg::print(address, HEX);
+      Msg::print(F(" after "));
+      Msg::print(millis() - _lastPowerOnEvent);
+      Msg::println(F(" milliseconds"));
     };
     
-    void DACControl::_initFail(String name)
+    void DACControl::_initFail(DACChip &dac)
     {
-        Msg::print(Msg::E, name);
+        dac.printName(Msg::E);
         Msg::print(Msg::E, F(" DAC failed to initialise after "));
-        Msg::print(Msg::E, String(millis() - _lastPowerOnEvent));
+        Msg::print(Msg::E, millis() - _lastPowerOnEvent);
         Msg::println(Msg::E, F(" milliseconds"));
     };
 
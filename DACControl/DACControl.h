@@ -1,5 +1,8 @@
 /*
   Class library for controlling one or more DACs
+
+  The DACs are held by the sketch and nothing is allocated from the heap. On AVR a DACControl uses 698 bytes of RAM with
+  the default DACCONTROL_MAX_DACS of 16, 559 with 8, 499 with 4 and 469 with 2. The event queue accounts for 143-159 of them.
 */
  
 //#define USE_ES9018
@@ -11,6 +14,10 @@
   #include <ES9018.h>
 #endif
 #include <ES9028.h>
+#include "DACStatus.h"
+#include "DACConfigStore.h"
+#include "DACHistory.h"
+#include "DACEvents.h"
 
 #ifndef DACControl_h
 #define DACControl_h
@@ -22,15 +29,39 @@
   #include "WConstants.h"
 #endif
 
+#ifndef DACCONTROL_MAX_POWER_PINS
+  #define DACCONTROL_MAX_POWER_PINS 4             // maximum number of power relay pins and of DAC reset pins
+#endif
+#ifndef DACCONTROL_MAX_TRIM_DACS
+  #if defined(ESP32) || defined(ESP8266)
+    #define DACCONTROL_MAX_TRIM_DACS DACCONTROL_MAX_DACS  // DACs with per channel and group trims, the others follow master volume and balance
+  #else
+    #define DACCONTROL_MAX_TRIM_DACS 4
+  #endif
+#endif
+#ifndef DACCONTROL_MAX_CHANNEL_GROUPS
+  #define DACCONTROL_MAX_CHANNEL_GROUPS 4
+#endif
+#define DACCONTROL_MAX_ATTENUATION 124            // highest attenuation setAttenuation() accepts, in 0.5dB steps
+#ifndef DACCONTROL_MAX_BUSES
+  #define DACCONTROL_MAX_BUSES 4                  // maximum number of distinct I2C buses the DACs can be spread across
+#endif
+
 class DACControl 
 {
   public:
     typedef void (*EventFunction) ();
+    typedef void (*RecoveryFunction) (byte dac, unsigned long recoveryTime);
     #ifdef USE_ES9018
       typedef bool (*ES9018Function) (ES9018* dac);
     #endif
     typedef bool (*ES9028Function) (ES9028* dac);
-    enum Input{I2S, SPDIF};
+    enum ConfigStep{Config_Continue, Config_Done, Config_Failed};
+    typedef ConfigStep (*ES9028StepFunction) (ES9028* dac, byte step);
+    enum InitStage{Init_Pending, Init_Mute, Init_Restore, Init_Configure, Init_Unmute, Init_Done, Init_Failed};
+    enum Input{I2S, SPDIF, DSD};
+    enum RateClass{Rate_PCM48k, Rate_PCM96k, Rate_PCM192k, Rate_DoP, Rate_DSD, Rate_None};
+    enum PowerStep{Power_Off, Power_RelayOn, Power_Probe, Power_Init, Power_On, Power_Mute, Power_RampDown, Power_ResetAssert, Power_RelayOff};
 
     #ifdef USE_ES9018
       DACControl(ES9018 es9018dacs[], byte es9018dacCount, ES9028 es9028dacs[], byte es9028dacCount);
@@ -41,6 +72,14 @@ class DACControl
       void initES9018(ES9018Function val);
     #endif
     void initES9028(ES9028Function val);
+    void initES9028Steps(ES9028StepFunction val);        // configures each DAC in steps (step = 0, 1, 2...) until Config_Done is returned, one step per init slot
+    void setInitStepsPerLoop(byte val);                   // number of init steps performed per loop() call (default 1)
+    DACControl::InitStage getInitStage(byte dac);         // init progress of a DAC (ES9018 DACs are numbered first)
+    bool initialising();                                  // true while the init state machine is running
+    void setStartupProbe(unsigned int minDelay, byte identicalReads, unsigned int maxDelay); // start init once every DAC returns the same chip ID identicalReads times in a row (0 = fixed maxDelay)
+    unsigned long getStartupTime();                       // milliseconds from power on until the DACs were ready at the last power on
+    void enableConfigCache(unsigned long profileId, unsigned int eepromOffset = 0); // persist each ES9028's configured register image and restore it on the next power on. Change profileId whenever the configuration callback changes
+    void clearConfigCache();                              // forces the configuration callback to run at the next power on
     void onBeforePowerOff(EventFunction val);
     void onAfterPowerOff(EventFunction val);
     void onBeforePowerOn(EventFunction val);
@@ -53,36 +92,92 @@ class DACControl
     void onInitialised(EventFunction val);
     void onNotInitialised(EventFunction val);
     void onAutomuteStatusChanged(EventFunction val);
+    bool subscribe(DACEventQueue::EventHandler handler);  // typed events with their payload, dispatched from loop() to every subscriber
+    void unsubscribe(DACEventQueue::EventHandler handler);
+    unsigned long getDroppedEvents();                     // events lost because more than DACCONTROL_EVENT_QUEUE_SIZE were raised in one loop()
+    void recordHistory(DACHistory &history, unsigned int interval = 1000); // adds a sample per DAC to history every interval ms and whenever a DAC's lock, automute or read error flag changes
+    unsigned int getI2CErrors(byte dac);                  // status read errors of a DAC since power on
+    void onInputSwitched(EventFunction val);              // called once an input switch has completed and the DACs are unmuted
+    void onDACRecovered(RecoveryFunction val);            // called after a DAC that lost its configuration (e.g. a brownout reset) was reconfigured, with the recovery time in ms
+    void setDriftCheckInterval(unsigned int val);         // ms between checks of one DAC's sentinel registers against the shadow copy (0 disables, default 1000)
+    void refreshShadow();                                 // re-reads the sentinel registers, call after changing ES9028 registers directly
     void begin();
     void powerOn();
-    void powerOff();
+    void powerOff();                                      // mutes, waits for the ramp, asserts reset then switches the relays off. Progresses in loop()
+    void setPowerDownTiming(unsigned int rampDown, unsigned int resetHold); // ms to wait for the mute ramp before asserting reset (default 10) and with reset asserted before the relays switch off (default 0)
+    DACControl::PowerStep getPowerStep();                 // current step of the power sequence, Power_On or Power_Off once it has completed
+    unsigned long getPowerTransitionTime();               // milliseconds the last completed power on (until initialised) or power off took
     DACControl::Input getInput();
-    bool getPower();
+    bool getPower();                                      // true from powerOn() until the relays have been switched off
     void togglePower();
     void mute();
     bool automuted();
     bool initialised();
+    bool errorInitialising();                             // true if any DAC failed to initialise at the last power on
     void unmute();
     void setSPDIF();
     void setUSB();
+    void setDSD();
+    void selectInput(DACControl::Input val);             // mutes, waits for the ramp, switches every DAC in one write each, waits for lock then unmutes. Progresses in loop()
+    void setInputSwitchTiming(DACControl::Input input, unsigned int rampTime, unsigned int lockTimeout); // ms to wait for the mute ramp (match the volume rate) and at most for lock when switching to input
+    bool switchingInput();                                // true while an input switch is in progress
+    unsigned long getInputSwitchTime();                   // milliseconds from the last input switch request until the DACs were unmuted
     void setNoI2C();
     void toggleInput();
     void loop();
-    int locked();
+    int locked();                                         // legacy encoding: lock in bit n, read error in bit n+8. Only valid for up to 8 DACs, use getStatus() instead
+    const DACStatus& getStatus();                         // status of each DAC as of the last poll
+    bool allLocked();                                     // true if every DAC was locked at the last poll
+    bool anyError();                                      // true if the status of any DAC could not be read at the last poll
     void setAttenuation(byte val);
+    bool setGroupAttenuation(byte val);                   // stages the attenuation on every ES9028 with volume latching disabled, then releases them back to back
+    unsigned long getVolumeSkew();                        // time in microseconds between the first and last DAC applying the last group attenuation
+    void setSynchronisedVolume(bool val);                 // when true setAttenuation() uses setGroupAttenuation()
+    void setFineAttenuation(unsigned int val);            // attenuation in 0.05dB steps (0 to 10 * DACCONTROL_MAX_ATTENUATION): whole 0.5dB steps through the volume registers, the rest through each ES9028's master trim
+    bool setFineTrim(byte dac, byte val);                 // 0.05dB steps (0-10) added to the master trim of one ES9028, to match the levels of several DACs
+    void setBalance(int val);                             // attenuation in 0.5dB steps added to the left channels (val > 0) or the right channels (val < 0). Sides follow each ES9028's mode, odd channels are left in stereo and eight channel mode
+    bool setChannelTrim(byte dac, byte channel, byte val); // attenuation in 0.5dB steps added to one channel (0-7) of an ES9028, e.g. to level the drivers of a crossover
+    bool setChannelGroup(byte dac, byte channels, byte group); // moves the channels of an ES9028 (bit n = channel n) into group (0 to DACCONTROL_MAX_CHANNEL_GROUPS-1)
+    bool setGroupTrim(byte group, byte val);              // attenuation in 0.5dB steps added to every channel of group
+    void requestAttenuation(byte val);                    // sets the attenuation target, written once per loop() so intermediate targets of a fast knob turn are dropped
+    void setVolumeRamp(byte val);                         // ES9028 volume ramp rate (0-7) applied after each init, lets the DAC smooth the steps between coalesced targets
+    unsigned long getVolumeLatency();                     // microseconds from the oldest request of the last applied target until every DAC was written
+    unsigned long getMaxVolumeLatency();                  // highest volume latency since power on
+    unsigned long getCoalescedVolumes();                  // targets dropped because a newer one arrived before they were written
+    bool volumePending();                                 // a requested attenuation is waiting to be written, e.g. until init completes
+    byte getAttenuation();                                // attenuation last written or set
     void setFilterShape(ES9028::FilterShape val);
-    void setPinDACReset(byte val);
-    void setPinPowerRelay(byte val);
+    void setRateProfile(DACControl::RateClass rate, ES9028::FilterShape filterShape, ES9028::IIR_Bandwidth iirBandwidth, ES9028::DpllBandwidth dpllSerial, ES9028::DpllBandwidth dpllDSD); // applied to every ES9028, muted, when the status poll sees the signal change to this class
+    void clearRateProfiles();
+    DACControl::RateClass getRateClass();                 // class of the incoming signal as of the last poll (only detected while a rate profile is set)
+    unsigned long getSampleRate();                        // sample rate in Hz as of the last poll (only detected while a rate profile is set)
+    void setPinDACReset(byte val);                        // replaces the DAC reset pins with val (255 = none)
+    void setPinPowerRelay(byte val);                      // replaces the power relay pins with val (255 = none)
+    bool addPinDACReset(byte val);                        // adds a reset pin, for DAC groups with separate resets. false if DACCONTROL_MAX_POWER_PINS are in use
+    bool addPinPowerRelay(byte val);                      // adds a relay pin, switched on in the order added and off in reverse
     void setPinSDA(byte val);
     void setPinSCL(byte val);
+    byte getBusCount();                                   // number of distinct I2C buses the DACs are connected to
 
   private: 
 
-     const int _initDelay = 1500;                          // delay before attempting to initialise DACs after poweron
+     unsigned int _startupMinDelay = 100;                 // delay before probing the DACs after poweron
+     unsigned int _startupMaxDelay = 1500;                // delay after which init starts even if not every DAC answered
+     byte _startupReads = 3;                              // consecutive identical chip ID reads before a DAC is considered ready
+     const unsigned int _probeIntervalMin = 10;           // probe interval in ms, doubled while DACs are not answering
+     const unsigned int _probeIntervalMax = 160;
+     unsigned int _probeInterval = 10;
+     unsigned long _lastProbe = 0;
+     unsigned long _startupTime = 0;
+     boolean _probing = false;
+     byte _probeCount[DACCONTROL_MAX_DACS];               // consecutive identical chip ID reads of each DAC
+     byte _probeId[DACCONTROL_MAX_DACS];                  // last chip ID read from each DAC
      const unsigned int _delayUnmute = 250;                // wait for AVB to properly lock onto stream
      const unsigned int _lockSampleInterval = 250;         // lock sample interval in ms
-     byte _pinPowerRelay = 255;
-     byte _pinDACReset = 255;
+     byte _pinPowerRelay[DACCONTROL_MAX_POWER_PINS];
+     byte _pinPowerRelayCount = 0;
+     byte _pinDACReset[DACCONTROL_MAX_POWER_PINS];
+     byte _pinDACResetCount = 0;
      byte _pinSDA = 255;
      byte _pinSCL = 255;
      byte _addrI2C;
@@ -90,44 +185,164 @@ class DACControl
      #ifdef USE_ES9018
      ES9018 *_es9018dacs = NULL;
      byte _es9018dacCount = 0;
-     ES9018Function _initES9018;
+     ES9018Function _initES9018 = NULL;
      #endif
      ES9028 *_es9028dacs = NULL;
      byte _es9028dacCount = 0;
+     DACChip *_chips[DACCONTROL_MAX_DACS] = {};           // all DACs in index order, ES9018s first
      boolean _power = false;
+     PowerStep _powerStep = Power_Off;
+     boolean _powerOnPending = false;                     // powerOn() was called during the power down sequence
+     unsigned int _powerRampDown = 10;                    // wait for the mute ramp before asserting reset
+     unsigned int _powerResetHold = 0;                    // time reset is held before the relays switch off
+     unsigned long _powerStart = 0;                       // start of the current power transition
+     unsigned long _powerStepStart = 0;
+     unsigned long _powerTime = 0;                        // duration of the last completed power transition
      boolean _automuted = false;
-     boolean _inputSPDIF = false;
+     Input _input = I2S;
+     static const byte _inputCount = 3;
+     enum SwitchStage{Switch_Idle, Switch_Ramp, Switch_Lock};
+     SwitchStage _switchStage = Switch_Idle;
+     unsigned int _switchRampTime[_inputCount] = {50, 50, 50};       // mute ramp time per input
+     unsigned int _switchLockTimeout[_inputCount] = {1000, 1000, 1000}; // longest wait for lock per input
+     const unsigned int _switchPollInterval = 5;          // lock poll interval in ms while switching
+     unsigned long _switchStart = 0;
+     unsigned long _switchStageStart = 0;
+     unsigned long _lastSwitchPoll = 0;
+     unsigned long _switchTime = 0;                       // duration of the last input switch
+     static const byte _rateClassCount = 5;
+     ES9028::FilterProfile _rateProfiles[_rateClassCount]; // filter settings for each rate class
+     byte _rateProfileSet = 0;                            // bit n is set if rate class n has a profile
+     RateClass _rateClass = Rate_None;
+     unsigned long _sampleRate = 0;
+     ES9028::SignalType _signalType = ES9028::Signal_NONE;
+     DACEventQueue _events;
+     DACHistory *_history = NULL;
+     unsigned int _historyInterval = 1000;
+     unsigned long _previousHistoryMillis = 0;
+     unsigned int _i2cErrors[DACCONTROL_MAX_DACS] = {};   // status read errors of each DAC since power on
      unsigned long _lastPowerOnEvent = 0;                 // last time power to DACs turned on
      unsigned long _previousLockSampleMillis = 0;         // last time lock status was sampled
      unsigned long _previousPowerLightMillis = 0;         // last time power light toggled
-     int _prevSignalLock = -1;                            // previous signal lock state
+     DACStatus _status;                                   // status of each DAC as of the last poll
+     boolean _statusValid = false;                        // false until the first poll after initialisation
      int _clockStretchLimit = -1;
+     boolean _synchronisedVolume = false;
+     unsigned long _volumeSkew = 0;                       // microseconds between first and last volume release
+     boolean _volumePending = false;                      // a requested attenuation is waiting to be written
+     byte _volumeTarget = 0;
+     unsigned long _volumeRequested = 0;                  // micros() of the oldest request since the last write
+     unsigned long _volumeLatency = 0;
+     unsigned long _volumeLatencyMax = 0;
+     unsigned long _volumeCoalesced = 0;
+     byte _volumeRate = 255;                              // ES9028 volume ramp rate, 255 leaves the DAC default
+     boolean _channelVolumes = false;                     // set by the first balance or trim, ES9028 volumes are then written per channel
+     int _balance = 0;
+     byte _fineAttenuation = 0;                           // 0.05dB steps below the 0.5dB volume step
+     boolean _fineAttenuationSet = false;
+     byte _fineTrim[DACCONTROL_MAX_TRIM_DACS] = {};       // 0.05dB steps added to each DAC's master trim
+     byte _channelTrim[DACCONTROL_MAX_TRIM_DACS][ES9028::ChannelCount] = {}; // attenuation added to each channel
+     byte _groupChannels[DACCONTROL_MAX_CHANNEL_GROUPS][DACCONTROL_MAX_TRIM_DACS] = {}; // channels of each DAC in the group
+     byte _groupTrim[DACCONTROL_MAX_CHANNEL_GROUPS] = {};
      boolean _initialised = false;
      boolean _errorInitialising = false;
-     ES9028Function _initES9028;
-     EventFunction _onLock;
-     EventFunction _onLockReadError;
-     EventFunction _onNoLock;
-     EventFunction _onBeforePowerOn;
-     EventFunction _onAfterPowerOn;
-     EventFunction _onBeforePowerOff;
-     EventFunction _onAfterPowerOff;
-     EventFunction _onInitialised;
-     EventFunction _onNotInitialised;
-     EventFunction _onAutomuteStatusChanged;
+     ES9028Function _initES9028 = NULL;
+     ES9028StepFunction _initES9028Steps = NULL;
+     byte _initStepsPerLoop = 1;
+     boolean _initStarted = false;
+     InitStage _initStage[DACCONTROL_MAX_DACS];            // init progress of each DAC
+     byte _initDAC = 0;                                   // DAC currently being initialised
+     byte _configStep = 0;                                // next step of the stepped configuration
+     DACConfigStore _configStore;
+     unsigned long _profileId = 0;
+     static const byte _sentinelCount = 4;
+     static const byte _sentinelRegs[_sentinelCount];     // registers compared against the shadow copy to detect a silent DAC reset
+     static const byte _sentinelMasks[_sentinelCount];    // bits of each sentinel register that DACControl itself never changes
+     byte _sentinels[DACCONTROL_MAX_DACS][_sentinelCount]; // shadow copy of each ES9028's sentinel registers
+     unsigned int _driftCheckInterval = 1000;
+     unsigned long _previousDriftCheckMillis = 0;
+     byte _driftCheckDAC = 0;                             // ES9028 checked next
+     boolean _muted = false;                              // settings made through DACControl, reapplied after a recovery
+     boolean _inputSelected = false;
+     boolean _attenuationSet = false;
+     byte _attenuation = 0;
+     boolean _filterShapeSet = false;
+     byte _filterShape = 0;
+
+     // broadcast operations are run on each I2C bus in turn (or concurrently, one task per bus, on the ESP32)
+     enum Operation{Op_Mute, Op_Unmute, Op_SetAttenuation, Op_SetFilterShape, Op_SelectSPDIF, Op_SelectSerial, Op_SelectDSD, Op_ReadStatus, Op_StageVolume, Op_VerifyVolumeLatch, Op_ApplyProfile, Op_SetVolumeRate, Op_SetVolumes, Op_SetFineAttenuation};
+     enum OperationResult{Result_OK=1, Result_Locked=2, Result_Automuted=4};
+     TwoWire *_buses[DACCONTROL_MAX_BUSES];
+     byte _busCount = 0;
+     byte _dacBus[DACCONTROL_MAX_DACS];                   // bus index of each DAC
+     byte _busOrder[DACCONTROL_MAX_DACS];                 // DAC indices interleaved across buses
+     byte _opResult[DACCONTROL_MAX_DACS];                 // OperationResult flags of the last broadcast for each DAC
+     Operation _op;
+     byte _opArg;
+     #if defined(ESP32)
+     struct BusWorker
+     {
+       DACControl *dacCtrl;
+       byte bus;
+       TaskHandle_t task;
+     };
+     BusWorker _busWorkers[DACCONTROL_MAX_BUSES];
+     SemaphoreHandle_t _busDone = NULL;
+     static void _busTask(void *param);
+     void _startBusTasks();
+     #endif
+     EventFunction _onLock = NULL;
+     EventFunction _onLockReadError = NULL;
+     EventFunction _onNoLock = NULL;
+     EventFunction _onBeforePowerOn = NULL;
+     EventFunction _onAfterPowerOn = NULL;
+     EventFunction _onBeforePowerOff = NULL;
+     EventFunction _onAfterPowerOff = NULL;
+     EventFunction _onInitialised = NULL;
+     EventFunction _onNotInitialised = NULL;
+     EventFunction _onAutomuteStatusChanged = NULL;
+     EventFunction _onInputSwitched = NULL;
+     RecoveryFunction _onDACRecovered = NULL;
 
-     int _allLockedValue();
+     byte _dacCount();
+     void _readStatus(DACStatus &status);
+     void _assignBuses();
+     void _broadcast(Operation op, byte arg = 0);
+     void _runBus(byte bus);
+     byte _apply(byte dac, Operation op, byte arg);
      void _eventInitialised();
      void _eventAutomuteStatusChange();
      boolean _initSuccess();
+     void _startPowerOn();
+     void _powerDown();
+     void _setPowerStep(PowerStep step);
+     void _writePins(const byte pins[], byte count, byte level, bool reverse = false);
      void _eventBeforePowerOn();
      void _eventAfterPowerOn();
      void _eventBeforePowerOff();
      void _eventAfterPowerOff();
      void _disableDACs();
      void _enableDACs();
+     bool _startupReady();
      void _initDACs();
-     void _initFail(String name);
+     bool _initStep(byte d);
+     void _initFound(byte address);
+     unsigned long _profileHash(ES9028 &dac);
+     void _saveConfig(byte slot, ES9028 &dac);
+     Operation _selectOp(Input val);
+     RateClass _classifyRate(ES9028::SignalType type, unsigned long sampleRate);
+     void _detectRate(const DACStatus &status);
+     void _recordHistory(const DACStatus &status);
+     void _raiseStatusEvents(const DACStatus &status);
+     void _switchInputs();
+     void _applyVolume();
+     void _applyChannelVolumes();
+     void _channelVolumesOf(byte d, DACChip &dac, byte vals[]);
+     void _setChips();
+     bool _readSentinels(ES9028 &dac, byte vals[]);
+     void _checkDrift();
+     void _recoverDAC(byte slot);
+     void _initFail(DACChip &dac);
 
 };
 
@@ -0,0 +1,212 @@
+/*
+  DACControl variant for a DAC set that is fixed at compile time, e.g. DACControlT<ES9028, ES9028, ES9018>.
+  The chips are held by value and every per-DAC operation is unrolled by the compiler, without virtual calls.
+  Lock, automute and read error flags are kept in the smallest integer that holds one bit per DAC.
+  On AVR the RAM used is the chips themselves (44 bytes per ES9028, 42 per ES9018) plus 17 bytes of state for up to 8 DACs,
+  e.g. 105 bytes for DACControlT<ES9028, ES9028>. Nothing is allocated from the heap.
+*/
+
+#include <global.h>
+#include <SerialHelper.h>
+#include <DACChip.h>
+#include <ES9028.h>
+
+#ifndef DACControlT_h
+#define DACControlT_h
+#if ARDUINO >= 100
+  #include "Arduino.h"
+#else
+  #include "WProgram.h"
+  #include "pins_arduino.h"
+  #include "WConstants.h"
+#endif
+
+// smallest unsigned type with at least N bits
+template <byte N, bool Byte = (N <= 8), bool Word = (N <= 16)>
+struct DACMask { typedef unsigned long type; };
+template <byte N, bool Word>
+struct DACMask<N, true, Word> { typedef byte type; };
+template <byte N>
+struct DACMask<N, false, true> { typedef unsigned int type; };
+
+// chip properties DACControlT needs at compile time
+template <class Chip>
+struct DACChipTraits
+{
+  static constexpr bool automute = false;            // chip reports automute
+};
+template <>
+struct DACChipTraits<ES9028>
+{
+  static constexpr bool automute = true;
+};
+
+template <byte I>
+struct DACIndex {};
+
+// recursive list of DAC chips, DAC I is held at the level of DACChipList<Mask, I, ...>
+template <class Mask, byte I, class... Chips>
+class DACChipList
+{
+  public:
+    static constexpr Mask automuteMask() { return 0; }
+    void chip() {}
+    Mask initialise() { return 0; }
+    Mask reset() { return 0; }
+    Mask mute() { return 0; }
+    Mask unmute() { return 0; }
+    Mask selectSource(DACChip::Source) { return 0; }
+    Mask setMasterAttenuation(byte) { return 0; }
+    Mask readStatus(Mask &, Mask &) { return 0; }
+    Mask initialised() { return 0; }
+    void printLocks(Mask) {}
+};
+
+template <class Mask, byte I, class Head, class... Tail>
+class DACChipList<Mask, I, Head, Tail...> : public DACChipList<Mask, I + 1, Tail...>
+{
+  typedef DACChipList<Mask, I + 1, Tail...> Next;
+
+  public:
+    DACChipList(const Head &head, const Tail&... tail) : Next(tail...), _chip(head) {}
+
+    static constexpr Mask bit() { return (Mask) 1 << I; }
+    static constexpr Mask automuteMask() { return (DACChipTraits<Head>::automute ? bit() : 0) | Next::automuteMask(); }
+
+    using Next::chip;
+    Head &chip(DACIndex<I>) { return _chip; }
+
+    // each operation returns a mask of the DACs that failed. Qualified calls bind statically to the chip class
+    Mask initialise() { return (_chip.Head::initialise() ? 0 : bit()) | Next::initialise(); }
+    Mask reset() { return (_chip.Head::reset() ? 0 : bit()) | Next::reset(); }
+    Mask mute() { return (_chip.Head::mute() ? 0 : bit()) | Next::mute(); }
+    Mask unmute() { return (_chip.Head::unmute() ? 0 : bit()) | Next::unmute(); }
+    Mask selectSource(DACChip::Source val) { return (_chip.Head::selectSource(val) ? 0 : bit()) | Next::selectSource(val); }
+    Mask setMasterAttenuation(byte val) { return (_chip.Head::setMasterAttenuation(val) ? 0 : bit()) | Next::setMasterAttenuation(val); }
+    Mask initialised() { return (_chip.Head::getInitialised() ? bit() : 0) | Next::initialised(); }
+
+    Mask readStatus(Mask &locked, Mask &automuted)
+    {
+      bool lock, automute;
+      Mask errors = 0;
+      if (_chip.Head::readStatus(lock, automute))
+      {
+        if (lock)
+          locked |= bit();
+        if (automute)
+          automuted |= bit();
+      }
+      else
+        errors = bit();
+      return errors | Next::readStatus(locked, automuted);
+    }
+
+    void printLocks(Mask locked)
+    {
+      _chip.printName();
+      if (locked & bit())
+        Msg::println(F(" DAC locked"));
+      else
+        Msg::println(F(" DAC not locked"));
+      Next::printLocks(locked);
+    }
+
+  private:
+    Head _chip;
+};
+
+template <class... Chips>
+class DACControlT
+{
+  public:
+    typedef void (*EventFunction) ();
+    typedef typename DACMask<sizeof...(Chips)>::type Mask;
+    static constexpr byte count = sizeof...(Chips);
+    static constexpr Mask allMask = (Mask) (((count < 32) ? (1UL << (count & 31)) : 0UL) - 1);
+    static constexpr Mask automuteMask = DACChipList<Mask, 0, Chips...>::automuteMask();
+
+    DACControlT(const Chips&... chips) : _chips(chips...)
+    {
+      static_assert(count > 0, "DACControlT needs at least one DAC");
+      static_assert(count <= 32, "DACControlT supports up to 32 DACs");
+    }
+
+    template <byte I>
+    auto dac() -> decltype(((DACChipList<Mask, 0, Chips...>*) NULL)->chip(DACIndex<I>()))  // DAC I, with its own class
+    {
+      return _chips.chip(DACIndex<I>());
+    }
+
+    bool initialise()                                  // initialises every DAC and leaves them muted. Returns false if any DAC failed
+    {
+      Mask failed = _chips.initialise();
+      _chips.mute();
+      _muted = true;
+      _lockValid = false;
+      if (failed != 0)
+        Msg::println(Msg::E, F("DAC initialisation failed"));
+      return failed == 0;
+    }
+
+    bool initialised() { return _chips.initialised() == allMask; }
+    bool reset() { return _chips.reset() == 0; }
+
+    void loop()
+    {
+      if (millis() - _previousLockSampleMillis < _lockSampleInterval)
+        return;
+      _previousLockSampleMillis = millis();
+      Mask locked = 0;
+      Mask automuted = 0;
+      Mask errors = _chips.readStatus(locked, automuted);
+      _automuted = (automuteMask != 0) && ((automuted & automuteMask) == automuteMask);
+      if (_lockValid && (locked == _locked) && (errors == _errors))
+        return;
+      _locked = locked;
+      _errors = errors;
+      _lockValid = true;
+      if (locked == allMask)
+      {
+        if (_onLock != NULL)
+          _onLock();
+      }
+      else if (errors == 0)
+      {
+        if (_onNoLock != NULL)
+          _onNoLock();
+      }
+      else if (_onLockReadError != NULL)
+        _onLockReadError();
+      _chips.printLocks(locked);
+    }
+
+    void onLock(EventFunction val) { _onLock = val; }
+    void onNoLock(EventFunction val) { _onNoLock = val; }
+    void onLockReadError(EventFunction val) { _onLockReadError = val; }
+
+    bool mute() { _muted = true; return _chips.mute() == 0; }
+    bool unmute() { _muted = false; return _chips.unmute() == 0; }
+    boolean muted() { return _muted; }
+    bool selectSource(DACChip::Source val) { return _chips.selectSource(val) == 0; }
+    bool setAttenuation(byte val) { return _chips.setMasterAttenuation(val) == 0; }
+
+    bool locked() { return _lockValid && (_locked == allMask); } // every DAC locked at the last status read
+    boolean automuted() { return _automuted; }                      // every DAC that reports automute is automuted
+    Mask getLockMask() { return _locked; }                          // bit n set if DAC n was locked at the last status read
+    Mask getReadErrors() { return _errors; }                        // bit n set if the last status read of DAC n failed
+
+  private:
+    DACChipList<Mask, 0, Chips...> _chips;
+    const unsigned int _lockSampleInterval = 250;     // lock sample interval in ms
+    unsigned long _previousLockSampleMillis = 0;
+    Mask _locked = 0;
+    Mask _errors = 0;
+    boolean _lockValid = false;
+    boolean _automuted = false;
+    boolean _muted = false;
+    EventFunction _onLock = NULL;
+    EventFunction _onNoLock = NULL;
+    EventFunction _onLockReadError = NULL;
+};
+
+#endif
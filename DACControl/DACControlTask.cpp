@@ -0,0 +1,247 @@
+#include <global.h>
+#include "SerialHelper.h"
+#include "DACControlTask.h"
+
+DACControlTask::DACControlTask(DACControl &dacCtrl)
+{
+  _dacCtrl = &dacCtrl;
+  #ifdef DACCONTROLTASK_STD_THREAD
+  _running = false;
+  #endif
+}
+
+bool DACControlTask::begin(unsigned int period, byte priority, int core)
+{
+  _period = period;
+  #if defined(ESP32)
+  if (_task != NULL)
+    return true;
+  // DACControl's per bus I2C tasks inherit this task's priority
+  return xTaskCreatePinnedToCore(_taskMain, "DACControl", 4096, this, priority, &_task, core) == pdPASS;
+  #elif defined(DACCONTROLTASK_STD_THREAD)
+  (void) priority;
+  (void) core;
+  if (_running)
+    return true;
+  _running = true;
+  _thread = std::thread([this]()
+  {
+    while (_running)
+    {
+      loop();
+      std::this_thread::sleep_for(std::chrono::milliseconds(_period));
+    }
+  });
+  return true;
+  #else
+  (void) priority;
+  (void) core;
+  return false;
+  #endif
+}
+
+void DACControlTask::end()
+{
+  #if defined(ESP32)
+  if (_task != NULL)
+  {
+    vTaskDelete(_task);
+    _task = NULL;
+  }
+  #elif defined(DACCONTROLTASK_STD_THREAD)
+  if (_running)
+  {
+    _running = false;
+    _thread.join();
+  }
+  #endif
+}
+
+#if defined(ESP32)
+void DACControlTask::_taskMain(void *param)
+{
+  DACControlTask *task = (DACControlTask*) param;
+  while (true)
+  {
+    task->loop();
+    // commands wake the task early so they are not held up for a whole period
+    ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(task->_period));
+  }
+}
+#endif
+
+void DACControlTask::loop()
+{
+  _applyCommands();
+  _dacCtrl->loop();
+  _queueEvents();
+}
+
+void DACControlTask::setAttenuation(byte val)
+{
+  _attenuation.set(val);
+  _wake();
+}
+
+void DACControlTask::mute()
+{
+  _mute.set(true);
+  _wake();
+}
+
+void DACControlTask::unmute()
+{
+  _mute.set(false);
+  _wake();
+}
+
+void DACControlTask::selectInput(DACControl::Input val)
+{
+  _input.set(val);
+  _wake();
+}
+
+bool DACControlTask::setFilterShape(ES9028::FilterShape val)
+{
+  return _post(Cmd_SetFilterShape, val);
+}
+
+bool DACControlTask::setRateProfile(DACControl::RateClass rate, ES9028::FilterShape filterShape, ES9028::IIR_Bandwidth iirBandwidth, ES9028::DpllBandwidth dpllSerial, ES9028::DpllBandwidth dpllDSD)
+{
+  return _post(Cmd_SetRateProfile, rate, filterShape, iirBandwidth, dpllSerial, dpllDSD);
+}
+
+bool DACControlTask::powerOn()
+{
+  return _post(Cmd_PowerOn);
+}
+
+bool DACControlTask::powerOff()
+{
+  return _post(Cmd_PowerOff);
+}
+
+bool DACControlTask::pollEvent(Event &event)
+{
+  return _events.pop(event);
+}
+
+unsigned long DACControlTask::getCoalesced()
+{
+  return _coalesced;
+}
+
+unsigned long DACControlTask::getDroppedEvents()
+{
+  return _droppedEvents;
+}
+
+bool DACControlTask::_post(CommandType type, byte arg0, byte arg1, byte arg2, byte arg3, byte arg4)
+{
+  Command command;
+  command.type = type;
+  command.args[0] = arg0;
+  command.args[1] = arg1;
+  command.args[2] = arg2;
+  command.args[3] = arg3;
+  command.args[4] = arg4;
+  if (!_commands.push(command))
+    return false;
+  _wake();
+  return true;
+}
+
+void DACControlTask::_wake()
+{
+  #if defined(ESP32)
+  if (_task != NULL)
+    xTaskNotifyGive(_task);
+  #endif
+}
+
+void DACControlTask::_event(EventType type, byte value)
+{
+  Event event;
+  event.type = type;
+  event.value = value;
+  if (!_events.push(event))
+    _droppedEvents++;
+}
+
+void DACControlTask::_applyCommands()
+{
+  // queued commands first so that power on is done before any settings, then the latest of each coalesced setting
+  Command command;
+  while (_commands.pop(command))
+  {
+    switch (command.type)
+    {
+      case Cmd_SetFilterShape:
+        _dacCtrl->setFilterShape((ES9028::FilterShape) command.args[0]);
+        break;
+      case Cmd_SetRateProfile:
+        _dacCtrl->setRateProfile((DACControl::RateClass) command.args[0], (ES9028::FilterShape) command.args[1], (ES9028::IIR_Bandwidth) command.args[2], (ES9028::DpllBandwidth) command.args[3], (ES9028::DpllBandwidth) command.args[4]);
+        break;
+      case Cmd_PowerOn:
+        _dacCtrl->powerOn();
+        break;
+      case Cmd_PowerOff:
+        _dacCtrl->powerOff();
+        break;
+    }
+  }
+  byte val;
+  if (_input.take(val, _coalesced))
+    _dacCtrl->selectInput((DACControl::Input) val);
+  if (_mute.take(val, _coalesced))
+  {
+    if (val)
+      _dacCtrl->mute();
+    else
+      _dacCtrl->unmute();
+  }
+  // held by DACControl until the DACs are initialised, Event_AttenuationApplied is queued once it has been written
+  if (_attenuation.take(val, _coalesced))
+  {
+    _dacCtrl->requestAttenuation(val);
+    _attenuationPending = true;
+  }
+}
+
+void DACControlTask::_queueEvents()
+{
+  bool power = _dacCtrl->getPower();
+  if (power != _power)
+  {
+    _power = power;
+    _event(power ? Event_PowerOn : Event_PowerOff);
+  }
+  bool initialised = _dacCtrl->initialised();
+  if (initialised != _initialised)
+  {
+    _initialised = initialised;
+    if (initialised)
+      _event(_dacCtrl->errorInitialising() ? Event_NotInitialised : Event_Initialised);
+  }
+  bool locked = initialised && _dacCtrl->allLocked();
+  if (locked != _locked)
+  {
+    _locked = locked;
+    _event(locked ? Event_Locked : Event_NoLock);
+  }
+  bool automuted = initialised && _dacCtrl->automuted();
+  if (automuted != _automuted)
+  {
+    _automuted = automuted;
+    _event(automuted ? Event_Automuted : Event_AutomuteCleared);
+  }
+  if (_attenuationPending && !_dacCtrl->volumePending())
+  {
+    _attenuationPending = false;
+    _event(Event_AttenuationApplied, _dacCtrl->getAttenuation());
+  }
+  bool switching = _dacCtrl->switchingInput();
+  if (_switching && !switching)
+    _event(Event_InputSwitched, _dacCtrl->getInput());
+  _switching = switching;
+}
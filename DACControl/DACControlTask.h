@@ -0,0 +1,162 @@
+/*
+  Runs DACControl in its own task (a FreeRTOS task on the ESP32, a std::thread in host builds) so that WiFi or web UI
+  work cannot starve it. Commands are passed in through lock-free queues and events are passed back the same way.
+  Volume, mute and input select only keep the latest request, so a burst of volume changes costs a single DAC write.
+  Boards without a task (AVR, ESP8266) call loop() from the sketch, which still decouples interrupt handlers from I2C
+*/
+
+#ifndef DACControlTask_h
+#define DACControlTask_h
+#if ARDUINO >= 100
+  #include "Arduino.h"
+#else
+  #include "WProgram.h"
+  #include "pins_arduino.h"
+  #include "WConstants.h"
+#endif
+#include "DACControl.h"
+
+#if !defined(ESP32) && !defined(ARDUINO)
+  #define DACCONTROLTASK_STD_THREAD                 // host builds stand in std::thread for the RTOS task (can also be defined to force it)
+#endif
+#ifdef DACCONTROLTASK_STD_THREAD
+  #include <atomic>
+  #include <thread>
+#endif
+
+#ifndef DACCONTROLTASK_QUEUE_SIZE
+  #define DACCONTROLTASK_QUEUE_SIZE 8               // entries in the command and event queues (one is always left free)
+#endif
+
+// single producer, single consumer ring buffer. The producer only writes _head and the consumer only writes _tail,
+// so byte sized atomic loads and stores are enough on every target
+template <typename T, byte N>
+class DACQueue
+{
+  public:
+    bool push(const T &item)
+    {
+      byte head = __atomic_load_n(&_head, __ATOMIC_RELAXED);
+      byte next = (head + 1) % N;
+      if (next == __atomic_load_n(&_tail, __ATOMIC_ACQUIRE))
+        return false;
+      _items[head] = item;
+      __atomic_store_n(&_head, next, __ATOMIC_RELEASE);
+      return true;
+    }
+
+    bool pop(T &item)
+    {
+      byte tail = __atomic_load_n(&_tail, __ATOMIC_RELAXED);
+      if (tail == __atomic_load_n(&_head, __ATOMIC_ACQUIRE))
+        return false;
+      item = _items[tail];
+      __atomic_store_n(&_tail, (byte)((tail + 1) % N), __ATOMIC_RELEASE);
+      return true;
+    }
+
+  private:
+    T _items[N];
+    byte _head = 0;
+    byte _tail = 0;
+};
+
+// latest value wins: the producer writes the value and then bumps a sequence number, the consumer applies the value
+// once for each change it sees and counts the values it never saw as coalesced (up to 255 changes between takes)
+class DACLatest
+{
+  public:
+    void set(byte val)
+    {
+      __atomic_store_n(&_value, val, __ATOMIC_RELAXED);
+      __atomic_store_n(&_sequence, (byte)(__atomic_load_n(&_sequence, __ATOMIC_RELAXED) + 1), __ATOMIC_RELEASE);
+    }
+
+    bool take(byte &val, unsigned long &coalesced)
+    {
+      byte sequence = __atomic_load_n(&_sequence, __ATOMIC_ACQUIRE);
+      if (sequence == _seen)
+        return false;
+      val = __atomic_load_n(&_value, __ATOMIC_RELAXED);
+      coalesced += (byte)(sequence - _seen) - 1;
+      _seen = sequence;
+      return true;
+    }
+
+  private:
+    byte _value = 0;
+    byte _sequence = 0;                             // written by the producer only
+    byte _seen = 0;                                 // used by the consumer only
+};
+
+class DACControlTask
+{
+  public:
+    enum EventType{Event_PowerOn, Event_PowerOff, Event_Initialised, Event_NotInitialised, Event_Locked, Event_NoLock, Event_Automuted, Event_AutomuteCleared, Event_InputSwitched, Event_AttenuationApplied};
+    struct Event
+    {
+      EventType type;
+      byte value;                                   // input for Event_InputSwitched, attenuation for Event_AttenuationApplied
+    };
+
+    DACControlTask(DACControl &dacCtrl);
+    bool begin(unsigned int period = 10, byte priority = 1, int core = 1); // starts the control task (ESP32 and host builds only, elsewhere call loop()). period is in ms
+    void end();
+    void loop();                                    // applies queued commands, runs DACControl::loop() and queues events
+
+    // commands, to be sent from a single task
+    void setAttenuation(byte val);                  // only the latest attenuation is applied
+    void mute();                                    // only the latest of mute() and unmute() is applied
+    void unmute();
+    void selectInput(DACControl::Input val);        // only the latest input is applied
+    bool setFilterShape(ES9028::FilterShape val);   // queued, false if the queue is full
+    bool setRateProfile(DACControl::RateClass rate, ES9028::FilterShape filterShape, ES9028::IIR_Bandwidth iirBandwidth, ES9028::DpllBandwidth dpllSerial, ES9028::DpllBandwidth dpllDSD);
+    bool powerOn();
+    bool powerOff();
+
+    bool pollEvent(Event &event);                   // returns false once no events are waiting, to be called from a single task
+    unsigned long getCoalesced();                   // commands superseded before they were applied
+    unsigned long getDroppedEvents();               // events lost because the UI did not poll often enough
+
+  private:
+    enum CommandType{Cmd_SetFilterShape, Cmd_SetRateProfile, Cmd_PowerOn, Cmd_PowerOff};
+    struct Command
+    {
+      CommandType type;
+      byte args[5];
+    };
+
+    DACControl *_dacCtrl;
+    DACQueue<Command, DACCONTROLTASK_QUEUE_SIZE> _commands;
+    DACQueue<Event, DACCONTROLTASK_QUEUE_SIZE> _events;
+    DACLatest _attenuation;
+    DACLatest _mute;
+    DACLatest _input;
+    unsigned long _coalesced = 0;
+    unsigned long _droppedEvents = 0;
+    unsigned int _period = 10;
+
+    // last state reported, to turn DACControl state changes into events
+    boolean _power = false;
+    boolean _initialised = false;
+    boolean _locked = false;
+    boolean _automuted = false;
+    boolean _switching = false;
+    boolean _attenuationPending = false;             // an attenuation was passed on and has not been reported yet
+
+    #if defined(ESP32)
+    TaskHandle_t _task = NULL;
+    static void _taskMain(void *param);
+    #elif defined(DACCONTROLTASK_STD_THREAD)
+    std::thread _thread;
+    std::atomic<bool> _running;
+    #endif
+
+    bool _post(CommandType type, byte arg0 = 0, byte arg1 = 0, byte arg2 = 0, byte arg3 = 0, byte arg4 = 0);
+    void _wake();
+    void _event(EventType type, byte value = 0);
+    void _applyCommands();
+    void _queueEvents();
+};
+
+#endif
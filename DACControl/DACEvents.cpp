@@ -0,0 +1,70 @@
+#include "DACEvents.h"
+
+bool DACEventQueue::subscribe(EventHandler handler)
+{
+  if (_handlerCount >= DACCONTROL_MAX_SUBSCRIBERS)
+    return false;
+  _handlers[_handlerCount++] = handler;
+  return true;
+}
+
+void DACEventQueue::unsubscribe(EventHandler handler)
+{
+  for (byte i = 0; i < _handlerCount; i++)
+  {
+    if (_handlers[i] == handler)
+    {
+      _handlerCount--;
+      for (byte j = i; j < _handlerCount; j++)
+        _handlers[j] = _handlers[j + 1];
+      return;
+    }
+  }
+}
+
+bool DACEventQueue::subscribed()
+{
+  return _handlerCount != 0;
+}
+
+DACEvent* DACEventQueue::raise(DACEvent::Type type, byte dac)
+{
+  if (_handlerCount == 0)
+    return NULL;
+  if (_count >= DACCONTROL_EVENT_QUEUE_SIZE)
+  {
+    _dropped++;
+    return NULL;
+  }
+  byte slot = _first + _count++;
+  if (slot >= DACCONTROL_EVENT_QUEUE_SIZE)
+    slot -= DACCONTROL_EVENT_QUEUE_SIZE;
+  DACEvent &event = _events[slot];
+  event.type = type;
+  event.dac = dac;
+  event.time = millis();
+  event.oldMask.clear();
+  event.newMask.clear();
+  event.value = 0;
+  event.detail = 0;
+  return &event;
+}
+
+void DACEventQueue::dispatch()
+{
+  // a handler may raise further events, they are dispatched in the same call
+  while (_count > 0)
+  {
+    DACEvent event = _events[_first];
+    if (++_first >= DACCONTROL_EVENT_QUEUE_SIZE)
+      _first = 0;
+    _count--;
+    for (byte i = 0; i < _handlerCount; i++)
+      _handlers[i](event);
+  }
+}
+
+unsigned long DACEventQueue::dropped()
+{
+  return _dropped;
+}
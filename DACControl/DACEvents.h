@@ -0,0 +1,60 @@
+/*
+  Typed DACControl events carrying their payload, queued in a fixed size ring as they are raised and dispatched to every
+  subscriber from DACControl::loop(), so handlers never need to read the DACs again to find out what happened
+*/
+
+#ifndef DACEvents_h
+#define DACEvents_h
+#if ARDUINO >= 100
+  #include "Arduino.h"
+#else
+  #include "WProgram.h"
+  #include "pins_arduino.h"
+  #include "WConstants.h"
+#endif
+#include "DACStatus.h"
+
+#ifndef DACCONTROL_EVENT_QUEUE_SIZE
+  #define DACCONTROL_EVENT_QUEUE_SIZE 8             // events held between two loop() calls
+#endif
+#ifndef DACCONTROL_MAX_SUBSCRIBERS
+  #define DACCONTROL_MAX_SUBSCRIBERS 4
+#endif
+
+struct DACEvent
+{
+  enum Type{Event_PowerOn, Event_PowerOff, Event_Initialised, Event_Muted, Event_Unmuted, Event_LockChanged, Event_AutomuteChanged, Event_RateChanged, Event_InputSwitched, Event_Recovered, Event_Error, Event_PowerStep};
+  enum Error{Error_Read, Error_InitFailed, Error_NoLock, Error_RecoveryFailed};
+  static const byte AllDACs = 255;
+
+  Type type;
+  byte dac;                                         // DAC index (ES9018 DACs are numbered first), AllDACs if the event is not for one DAC
+  unsigned long time;                               // millis() when the event was raised
+  DACStatus::Bits oldMask;                          // Event_LockChanged: lock bits before and after, Event_AutomuteChanged: automute bits,
+  DACStatus::Bits newMask;                          // Event_Initialised: newMask holds the DACs that initialised
+  unsigned long value;                              // Event_RateChanged: sample rate (Hz), Event_InputSwitched and Event_Recovered: duration (ms), Event_PowerStep: ms since the transition started
+  byte detail;                                      // Event_RateChanged: ES9028::SignalType, Event_InputSwitched: DACControl::Input, Event_Error: Error, Event_PowerStep: DACControl::PowerStep
+};
+
+class DACEventQueue
+{
+  public:
+    typedef void (*EventHandler) (const DACEvent &event);
+
+    bool subscribe(EventHandler handler);           // returns false if DACCONTROL_MAX_SUBSCRIBERS handlers are already subscribed
+    void unsubscribe(EventHandler handler);
+    bool subscribed();                              // true if anyone is listening, so events can be skipped otherwise
+    DACEvent* raise(DACEvent::Type type, byte dac = DACEvent::AllDACs); // queues an event and returns it for the payload to be filled in, NULL if nobody is subscribed or the queue is full
+    void dispatch();                                // passes every queued event to every subscriber, oldest first
+    unsigned long dropped();                        // events lost because the queue was full
+
+  private:
+    DACEvent _events[DACCONTROL_EVENT_QUEUE_SIZE];
+    byte _first = 0;
+    byte _count = 0;
+    EventHandler _handlers[DACCONTROL_MAX_SUBSCRIBERS];
+    byte _handlerCount = 0;
+    unsigned long _dropped = 0;
+};
+
+#endif
@@ -0,0 +1,109 @@
+#include "DACHistory.h"
+
+void DACHistory::clear()
+{
+  _next = 0;
+  _count = 0;
+  _total = 0;
+}
+
+void DACHistory::add(const Sample &sample)
+{
+  _samples[_next] = sample;
+  if (++_next >= DACCONTROL_HISTORY_SIZE)
+    _next = 0;
+  if (_count < DACCONTROL_HISTORY_SIZE)
+    _count++;
+  _total++;
+}
+
+unsigned int DACHistory::count() const
+{
+  return _count;
+}
+
+unsigned long DACHistory::total() const
+{
+  return _total;
+}
+
+const DACHistory::Sample& DACHistory::get(unsigned int i) const
+{
+  // the oldest sample is at _next once the ring has wrapped
+  unsigned int slot = (_count < DACCONTROL_HISTORY_SIZE) ? i : _next + i;
+  if (slot >= DACCONTROL_HISTORY_SIZE)
+    slot -= DACCONTROL_HISTORY_SIZE;
+  return _samples[slot];
+}
+
+void DACHistory::printCSV(Print &out) const
+{
+  out.println(F("time,dac,locked,automuted,read_error,signal,sample_rate,i2c_errors"));
+  for (unsigned int i = 0; i < _count; i++)
+  {
+    const Sample &sample = get(i);
+    out.print(sample.time);
+    out.print(',');
+    out.print(sample.dac);
+    out.print(',');
+    out.print((sample.flags & Flag_Locked) ? 1 : 0);
+    out.print(',');
+    out.print((sample.flags & Flag_Automuted) ? 1 : 0);
+    out.print(',');
+    out.print((sample.flags & Flag_ReadError) ? 1 : 0);
+    out.print(',');
+    // same order as ES9028::SignalType
+    switch (sample.signalType)
+    {
+      case 0:
+        out.print(F("DoP"));
+        break;
+      case 1:
+        out.print(F("SPDIF"));
+        break;
+      case 2:
+        out.print(F("I2S"));
+        break;
+      case 3:
+        out.print(F("DSD"));
+        break;
+      default:
+        out.print(F("none"));
+        break;
+    }
+    out.print(',');
+    out.print(sample.sampleRate);
+    out.print(',');
+    out.println(sample.i2cErrors);
+  }
+}
+
+void DACHistory::writeBinary(Print &out) const
+{
+  // fields are written a byte at a time so the format does not depend on the struct layout of the board
+  out.write('D');
+  out.write('H');
+  out.write((uint8_t)1);
+  out.write(RecordSize);
+  out.write((uint8_t)_count);
+  out.write((uint8_t)(_count >> 8));
+  for (unsigned int i = 0; i < _count; i++)
+  {
+    const Sample &sample = get(i);
+    _writeLong(out, sample.time);
+    _writeLong(out, sample.sampleRate);
+    out.write((uint8_t)sample.i2cErrors);
+    out.write((uint8_t)(sample.i2cErrors >> 8));
+    out.write(sample.dac);
+    out.write(sample.flags);
+    out.write(sample.signalType);
+  }
+}
+
+void DACHistory::_writeLong(Print &out, unsigned long val)
+{
+  out.write((uint8_t)val);
+  out.write((uint8_t)(val >> 8));
+  out.write((uint8_t)(val >> 16));
+  out.write((uint8_t)(val >> 24));
+}
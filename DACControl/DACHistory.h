@@ -0,0 +1,56 @@
+/*
+  Time stamped history of DAC status samples kept in a fixed size ring buffer (no heap), filled by DACControl
+  so that the state leading up to a dropout can be dumped after the event as CSV or compact binary records
+*/
+
+#ifndef DACHistory_h
+#define DACHistory_h
+#if ARDUINO >= 100
+  #include "Arduino.h"
+#else
+  #include "WProgram.h"
+  #include "pins_arduino.h"
+  #include "WConstants.h"
+#endif
+
+#ifndef DACCONTROL_HISTORY_SIZE
+  #if defined(ESP32) || defined(ESP8266)
+    #define DACCONTROL_HISTORY_SIZE 512             // samples kept, the oldest are overwritten first
+  #else
+    #define DACCONTROL_HISTORY_SIZE 32
+  #endif
+#endif
+
+class DACHistory
+{
+  public:
+    enum Flag{Flag_Locked=1, Flag_Automuted=2, Flag_ReadError=4};
+    struct Sample
+    {
+      unsigned long time;                           // millis() when the sample was taken
+      unsigned long sampleRate;                     // Hz, 0 if unknown
+      unsigned int i2cErrors;                       // status read errors since power on
+      byte dac;                                     // DAC index (ES9018 DACs are numbered first)
+      byte flags;                                   // Flag bits
+      byte signalType;                              // ES9028::SignalType
+    };
+    static const byte RecordSize = 13;              // bytes per sample written by writeBinary()
+
+    void clear();
+    void add(const Sample &sample);
+    unsigned int count() const;                     // samples held, at most DACCONTROL_HISTORY_SIZE
+    unsigned long total() const;                    // samples added since the last clear(), including those overwritten
+    const DACHistory::Sample& get(unsigned int i) const; // 0 is the oldest sample held
+    void printCSV(Print &out) const;                // one line per sample, oldest first, with a header line
+    void writeBinary(Print &out) const;             // "DH", version, record size, count (2 bytes) then the little endian records, oldest first
+
+  private:
+    Sample _samples[DACCONTROL_HISTORY_SIZE];
+    unsigned int _next = 0;                         // slot the next sample is written to
+    unsigned int _count = 0;
+    unsigned long _total = 0;
+
+    static void _writeLong(Print &out, unsigned long val);
+};
+
+#endif
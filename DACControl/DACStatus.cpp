@@ -0,0 +1,83 @@
+#include "DACStatus.h"
+
+DACStatus::DACStatus(byte dacCount)
+{
+  _dacCount = (dacCount > DACCONTROL_MAX_DACS) ? DACCONTROL_MAX_DACS : dacCount;
+}
+
+void DACStatus::clear()
+{
+  _lock.clear();
+  _readError.clear();
+  _automute.clear();
+}
+
+byte DACStatus::dacCount() const
+{
+  return _dacCount;
+}
+
+void DACStatus::setLocked(byte dac, bool val)
+{
+  _lock.set(dac, val);
+}
+
+void DACStatus::setReadError(byte dac, bool val)
+{
+  _readError.set(dac, val);
+}
+
+void DACStatus::setAutomuted(byte dac, bool val)
+{
+  _automute.set(dac, val);
+}
+
+bool DACStatus::locked(byte dac) const
+{
+  return _lock.get(dac);
+}
+
+bool DACStatus::readError(byte dac) const
+{
+  return _readError.get(dac);
+}
+
+bool DACStatus::automuted(byte dac) const
+{
+  return _automute.get(dac);
+}
+
+bool DACStatus::allLocked() const
+{
+  return (_dacCount > 0) && (_lock.count() == _dacCount);
+}
+
+bool DACStatus::anyError() const
+{
+  return _readError.any();
+}
+
+const DACStatus::Bits& DACStatus::lockBits() const
+{
+  return _lock;
+}
+
+const DACStatus::Bits& DACStatus::readErrorBits() const
+{
+  return _readError;
+}
+
+const DACStatus::Bits& DACStatus::automuteBits() const
+{
+  return _automute;
+}
+
+bool DACStatus::operator==(const DACStatus &other) const
+{
+  return (_dacCount == other._dacCount) && (_lock == other._lock) && (_readError == other._readError) && (_automute == other._automute);
+}
+
+bool DACStatus::operator!=(const DACStatus &other) const
+{
+  return !(*this == other);
+}
@@ -0,0 +1,129 @@
+/*
+  Per-DAC status flags (lock, read error, automute) for DACControl, sized at compile time
+*/
+
+#ifndef DACStatus_h
+#define DACStatus_h
+#if ARDUINO >= 100
+  #include "Arduino.h"
+#else
+  #include "WProgram.h"
+  #include "pins_arduino.h"
+  #include "WConstants.h"
+#endif
+
+#ifndef DACCONTROL_MAX_DACS
+  #define DACCONTROL_MAX_DACS 16                     // maximum number of DACs (ES9018 + ES9028) managed by one DACControl
+#endif
+
+// fixed size bitset that keeps a running count of set bits so that all/any queries are O(1)
+template <byte N>
+class DACBitset
+{
+  public:
+    DACBitset()
+    {
+      clear();
+    }
+
+    void clear()
+    {
+      memset(_bits, 0, sizeof(_bits));
+      _count = 0;
+    }
+
+    bool get(byte i) const
+    {
+      if (i >= N)
+        return false;
+      return _bits[i >> 3] & (1 << (i & 7));
+    }
+
+    void set(byte i, bool val)
+    {
+      if ((i >= N) || (get(i) == val))
+        return;
+      if (val)
+      {
+        _bits[i >> 3] |= (1 << (i & 7));
+        _count++;
+      }
+      else
+      {
+        _bits[i >> 3] &= ~(1 << (i & 7));
+        _count--;
+      }
+    }
+
+    byte count() const                               // number of bits set
+    {
+      return _count;
+    }
+
+    bool any() const
+    {
+      return _count != 0;
+    }
+
+    byte size() const
+    {
+      return N;
+    }
+
+    unsigned long mask(byte offset = 0) const        // up to 32 bits starting at offset packed into a long
+    {
+      unsigned long result = 0;
+      for (byte i = 0; (i < 32) && (offset + i < N); i++)
+      {
+        if (get(offset + i))
+          result |= (1UL << i);
+      }
+      return result;
+    }
+
+    bool operator==(const DACBitset<N> &other) const
+    {
+      return (_count == other._count) && (memcmp(_bits, other._bits, sizeof(_bits)) == 0);
+    }
+
+    bool operator!=(const DACBitset<N> &other) const
+    {
+      return !(*this == other);
+    }
+
+  private:
+    byte _bits[(N + 7) / 8];
+    byte _count;
+};
+
+// status of every DAC managed by a DACControl. ES9018 DACs are numbered first, followed by ES9028 DACs
+class DACStatus
+{
+  public:
+    typedef DACBitset<DACCONTROL_MAX_DACS> Bits;
+
+    DACStatus(byte dacCount = 0);
+    void clear();
+    byte dacCount() const;
+    void setLocked(byte dac, bool val);
+    void setReadError(byte dac, bool val);
+    void setAutomuted(byte dac, bool val);
+    bool locked(byte dac) const;
+    bool readError(byte dac) const;
+    bool automuted(byte dac) const;
+    bool allLocked() const;                          // true if every DAC reported lock
+    bool anyError() const;                           // true if reading the status of any DAC failed
+    const Bits& lockBits() const;
+    const Bits& readErrorBits() const;
+    const Bits& automuteBits() const;
+    bool operator==(const DACStatus &other) const;
+    bool operator!=(const DACStatus &other) const;
+
+  private:
+    byte _dacCount;
+    Bits _lock;
+    Bits _readError;
+    Bits _automute;
+};
+
+#endif
@@ -0,0 +1,47 @@
+#include <ES9028.h>
+#include <DACControlT.h>
+
+/*
+  Drives 2 Sabre32 ES9028/38 DACs in dual mono with DACControlT, for a rig whose DACs are known at compile time.
+  Initialises the DACs, selects SPDIF, sets the attenuation to 25 (-12.5dB), unmutes them once both are locked,
+  and shows the lock status via the built in LED
+*/
+
+// Arduino digital pins
+const byte POWER_RELAY = 3;
+
+DACControlT<ES9028, ES9028> dacs(ES9028("Left Channel", ES9028::MonoLeft), ES9028("Right Channel", ES9028::MonoRight));
+
+void eventLocked()
+{
+  digitalWrite(LED_BUILTIN, true);   // turn the LED on if both DACs locked
+  dacs.unmute();
+}
+
+void eventNoLock()
+{
+  digitalWrite(LED_BUILTIN, false);  // turn the LED off if either DAC not locked
+  dacs.mute();
+}
+
+void setup() {
+  pinMode(LED_BUILTIN, OUTPUT);
+  pinMode(POWER_RELAY, OUTPUT);
+  digitalWrite(POWER_RELAY, HIGH);
+  delay(500);                        // wait for the DAC supplies to settle
+  Wire.begin();
+  if (dacs.initialise())
+  {
+    // each DAC keeps its own class, so chip specific settings are still available
+    dacs.dac<0>().setFilterShape(ES9028::Filter_Hybrid);
+    dacs.dac<1>().setFilterShape(ES9028::Filter_Hybrid);
+    dacs.selectSource(DACChip::Source_SPDIF);
+    dacs.setAttenuation(25);
+  }
+  dacs.onLock(eventLocked);
+  dacs.onNoLock(eventNoLock);
+}
+
+void loop() {
+  dacs.loop();
+}
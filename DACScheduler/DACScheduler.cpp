@@ -0,0 +1,135 @@
+#include <global.h>
+#include "SerialHelper.h"
+#include "DACScheduler.h"
+
+int DACScheduler::addTask(TaskFunction function, unsigned int period, byte priority, unsigned int deadline, unsigned long budget, const char *name)
+{
+  if (_taskCount >= DACSCHEDULER_MAX_TASKS)
+    return -1;
+  byte number = _taskCount++;
+  Task &task = _tasks[number];
+  task.function = function;
+  task.name = name;
+  task.period = period * 1000UL;
+  task.deadline = ((deadline == 0) ? period : deadline) * 1000UL;
+  task.budget = budget;
+  task.release = micros();
+  task.priority = priority;
+  memset(&task.stats, 0, sizeof(task.stats));
+  // insert after the tasks of the same or higher priority
+  byte i = number;
+  while ((i > 0) && (_tasks[_order[i - 1]].priority < priority))
+  {
+    _order[i] = _order[i - 1];
+    i--;
+  }
+  _order[i] = number;
+  return number;
+}
+
+void DACScheduler::run()
+{
+  for (byte i = 0; i < _taskCount; i++)
+  {
+    Task &task = _tasks[_order[i]];
+    unsigned long now = micros();
+    if ((long)(now - task.release) >= 0)
+      _runTask(task, now);
+  }
+}
+
+void DACScheduler::loop()
+{
+  run();
+  if (_taskCount == 0)
+    return;
+  // sleep until the earliest release
+  unsigned long now = micros();
+  long sleep = 0x7FFFFFFFL;
+  for (byte i = 0; i < _taskCount; i++)
+  {
+    long wait = (long)(_tasks[i].release - now);
+    if (wait < sleep)
+      sleep = wait;
+  }
+  if (sleep <= 0)
+    return;
+  // delay() lets the ESP8266/ESP32 service WiFi, the remainder is made up on the next loop
+  if (sleep >= 2000)
+    delay(sleep / 1000);
+  else
+    delayMicroseconds(sleep);
+}
+
+byte DACScheduler::getTaskCount()
+{
+  return _taskCount;
+}
+
+const DACScheduler::TaskStats& DACScheduler::getStats(byte task)
+{
+  if (task >= _taskCount)
+    task = 0;
+  return _tasks[task].stats;
+}
+
+void DACScheduler::resetStats()
+{
+  for (byte i = 0; i < _taskCount; i++)
+    memset(&_tasks[i].stats, 0, sizeof(_tasks[i].stats));
+}
+
+void DACScheduler::printStats()
+{
+  for (byte i = 0; i < _taskCount; i++)
+  {
+    Task &task = _tasks[i];
+    Msg::print(F("Task "));
+    if (task.name != NULL)
+      Msg::print(task.name);
+    else
+      Msg::print(i);
+    Msg::print(F(": runs "));
+    Msg::print(task.stats.runs);
+    Msg::print(F(", overruns "));
+    Msg::print(task.stats.overruns);
+    Msg::print(F(", missed deadlines "));
+    Msg::print(task.stats.missedDeadlines);
+    Msg::print(F(", max execution "));
+    Msg::print(task.stats.maxExecution);
+    Msg::print(F("us, max jitter "));
+    Msg::print(task.stats.maxJitter);
+    Msg::println(F("us"));
+  }
+}
+
+void DACScheduler::_runTask(Task &task, unsigned long start)
+{
+  unsigned long jitter = start - task.release;
+  task.function();
+  unsigned long finish = micros();
+  unsigned long execution = finish - start;
+  TaskStats &stats = task.stats;
+  stats.runs++;
+  if (execution > stats.maxExecution)
+    stats.maxExecution = execution;
+  if (jitter > stats.maxJitter)
+    stats.maxJitter = jitter;
+  if ((task.budget != 0) && (execution > task.budget))
+    stats.overruns++;
+  if (task.period == 0)
+  {
+    // runs on every loop
+    task.release = finish;
+    return;
+  }
+  if (finish - task.release > task.deadline)
+    stats.missedDeadlines++;
+  // the next release stays on the period grid so the rate does not drift, releases more than a period late are skipped
+  task.release += task.period;
+  while ((long)(finish - task.release) >= (long)task.period)
+  {
+    task.release += task.period;
+    stats.missedDeadlines++;
+  }
+}
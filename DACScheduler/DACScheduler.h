@@ -0,0 +1,64 @@
+/*
+  Cooperative scheduler for the DAC control loop. Each component (DACControl, DACVolumeControl, Msg...) runs as a task
+  with its own period, deadline, priority and time budget, and the scheduler sleeps until the next release instead of
+  the whole loop running at the rate of a fixed delay(). Overruns, missed deadlines, execution time and release jitter
+  are recorded per task
+*/
+
+#ifndef DACScheduler_h
+#define DACScheduler_h
+#if ARDUINO >= 100
+  #include "Arduino.h"
+#else
+  #include "WProgram.h"
+  #include "pins_arduino.h"
+  #include "WConstants.h"
+#endif
+
+#ifndef DACSCHEDULER_MAX_TASKS
+  #define DACSCHEDULER_MAX_TASKS 8                  // maximum number of tasks per scheduler
+#endif
+
+class DACScheduler
+{
+  public:
+    typedef void (*TaskFunction) ();
+    struct TaskStats
+    {
+      unsigned long runs;
+      unsigned long overruns;                       // runs that took longer than the budget
+      unsigned long missedDeadlines;                // runs that finished after the deadline, or releases skipped because the task ran late
+      unsigned long maxExecution;                   // longest run in microseconds
+      unsigned long maxJitter;                      // longest delay from release to start in microseconds
+    };
+
+    // period and deadline (0 = period) in milliseconds, budget in microseconds (0 = none). Higher priority tasks run first when several are due.
+    // Returns the task number, or -1 if DACSCHEDULER_MAX_TASKS tasks have already been added
+    int addTask(TaskFunction task, unsigned int period, byte priority = 0, unsigned int deadline = 0, unsigned long budget = 0, const char *name = NULL);
+    void run();                                     // runs every task that is due, highest priority first
+    void loop();                                    // run() and then sleep until the next release, call from the sketch loop() in place of delay()
+    byte getTaskCount();
+    const DACScheduler::TaskStats& getStats(byte task);
+    void resetStats();
+    void printStats();                              // logs the statistics of every task
+
+  private:
+    struct Task
+    {
+      TaskFunction function;
+      const char *name;
+      unsigned long period;                         // microseconds
+      unsigned long deadline;                       // microseconds after release
+      unsigned long budget;                         // microseconds
+      unsigned long release;                        // micros() of the next release
+      byte priority;
+      TaskStats stats;
+    };
+    Task _tasks[DACSCHEDULER_MAX_TASKS];            // indexed by task number
+    byte _order[DACSCHEDULER_MAX_TASKS];            // task numbers, highest priority first
+    byte _taskCount = 0;
+
+    void _runTask(Task &task, unsigned long start);
+};
+
+#endif
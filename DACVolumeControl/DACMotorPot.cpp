@@ -0,0 +1,143 @@
+#include <DACMotorPot.h>
+
+void DACMotorPot::setDeadband(unsigned int val)
+{
+  _deadband = val;
+}
+
+void DACMotorPot::setCoastTime(unsigned int val)
+{
+  _coastTime = val;
+}
+
+void DACMotorPot::setSettleTime(unsigned int val)
+{
+  _settleTime = val;
+}
+
+void DACMotorPot::setApproach(unsigned int val)
+{
+  _approach = val;
+}
+
+void DACMotorPot::setStallDetection(unsigned int counts, unsigned int time)
+{
+  _stallCounts = counts;
+  _stallTime = time;
+}
+
+void DACMotorPot::setTimeout(unsigned int val)
+{
+  _timeout = val;
+}
+
+void DACMotorPot::seek(int target, unsigned long now)
+{
+  _target = target;
+  _seekStart = now;
+  _tracking = false;
+  _velocity = 0;
+  _drive = Drive_Stop;
+  _lastMove = Drive_Stop;
+  _band = _deadband;
+  _state = Motor_Seeking;
+}
+
+void DACMotorPot::stop()
+{
+  if ((_state == Motor_Seeking) || (_state == Motor_Settling))
+    _state = Motor_Idle;
+}
+
+DACMotorPot::Drive DACMotorPot::update(int position, unsigned long now)
+{
+  if ((_state != Motor_Seeking) && (_state != Motor_Settling))
+    return Drive_Stop;
+  if (!_tracking)
+  {
+    _tracking = true;
+    _lastPosition = position;
+    _lastTime = now;
+    _startStallWindow(position, now);
+  }
+  else if (now != _lastTime)
+  {
+    long speed = ((long)(position - _lastPosition) << 6) / (long)(now - _lastTime);
+    _velocity += (speed - _velocity) / 4;
+    _lastPosition = position;
+    _lastTime = now;
+  }
+  if (now - _seekStart >= _timeout)
+  {
+    _state = Motor_Timeout;
+    return Drive_Stop;
+  }
+  if (_state == Motor_Settling)
+  {
+    if (now - _settleStart < _settleTime)
+      return Drive_Stop;
+    // coasted to a halt, hunt again only if it ended up outside the deadband
+    long error = (long)_target - position;
+    if ((_lastMove != Drive_Stop) && ((error > 0) != (_lastMove == Drive_Up)) && (_band < _approach))
+      _band *= 2;  // overshot: the smallest move is coarser than the deadband, accept a wider one rather than hunt
+    if ((error <= (long)_band) && (error >= -(long)_band))
+    {
+      _state = Motor_Reached;
+      _seekTime = now - _seekStart;
+      return Drive_Stop;
+    }
+    _state = Motor_Seeking;
+    _drive = Drive_Stop;
+    _startStallWindow(position, now);
+  }
+  if ((position - _stallPosition >= (int)_stallCounts) || (_stallPosition - position >= (int)_stallCounts))
+    _startStallWindow(position, now);
+  else if (now - _stallStart >= _stallTime)
+  {
+    _state = Motor_Stalled;
+    return Drive_Stop;
+  }
+  // switch off early by the distance the pot will coast at its current speed
+  long predicted = position + (_velocity * (long)_coastTime) / 64;
+  long error = (long)_target - predicted;
+  // a fast pot can step over the deadband between two readings, so passing the target also stops it
+  bool passed = ((_drive == Drive_Up) && (error < 0)) || ((_drive == Drive_Down) && (error > 0));
+  if (passed || ((error <= (long)_band) && (error >= -(long)_band)))
+  {
+    _state = Motor_Settling;
+    _settleStart = now;
+    if (_drive != Drive_Stop)
+      _lastMove = _drive;
+    _drive = Drive_Stop;
+    return Drive_Stop;
+  }
+  _drive = (error > 0) ? Drive_Up : Drive_Down;
+  if ((error < (long)_approach) && (error > -(long)_approach))
+  {
+    _pulse = !_pulse;
+    if (!_pulse)
+      return Drive_Stop;
+  }
+  return _drive;
+}
+
+DACMotorPot::State DACMotorPot::getState()
+{
+  return _state;
+}
+
+int DACMotorPot::getTarget()
+{
+  return _target;
+}
+
+unsigned long DACMotorPot::getSeekTime()
+{
+  return _seekTime;
+}
+
+void DACMotorPot::_startStallWindow(int position, unsigned long now)
+{
+  _stallPosition = position;
+  _stallStart = now;
+}
@@ -0,0 +1,62 @@
+/*
+  Closed loop position control of a motorised pot: bang-bang with a deadband, stopping early by the
+  distance the pot coasts. Free of any I/O, so it can be driven on the host by a simulated motor and pot.
+*/
+
+#ifndef DACMotorPot_h
+#define DACMotorPot_h
+#if ARDUINO >= 100
+  #include "Arduino.h"
+#else
+  #include "WProgram.h"
+  #include "pins_arduino.h"
+  #include "WConstants.h"
+#endif
+
+class DACMotorPot
+{
+  public:
+    enum Drive{Drive_Down = -1, Drive_Stop = 0, Drive_Up = 1};  // direction of the pot reading
+    enum State{Motor_Idle, Motor_Seeking, Motor_Settling, Motor_Reached, Motor_Stalled, Motor_Timeout};
+
+    void setDeadband(unsigned int val);                 // ADC counts either side of the target that count as reached (default 4)
+    void setCoastTime(unsigned int val);                // ms the pot keeps moving at its current speed after the motor stops (default 20)
+    void setSettleTime(unsigned int val);               // ms to wait after stopping before the position is checked again (default 50)
+    void setApproach(unsigned int val);                 // within this many ADC counts of the target the motor is pulsed on every other update to creep up on it (default 32)
+    void setStallDetection(unsigned int counts, unsigned int time); // stalled if the reading moves less than counts within time ms while driven (default 2, 250)
+    void setTimeout(unsigned int val);                  // ms a seek may take in total (default 5000)
+    void seek(int target, unsigned long now);
+    void stop();
+    DACMotorPot::Drive update(int position, unsigned long now); // call with every new reading, returns how to drive the motor
+    DACMotorPot::State getState();
+    int getTarget();
+    unsigned long getSeekTime();                        // ms the last successful seek took
+
+  private:
+    unsigned int _deadband = 4;
+    unsigned int _coastTime = 20;
+    unsigned int _settleTime = 50;
+    unsigned int _approach = 32;
+    boolean _pulse = false;                             // alternates while creeping within the approach distance
+    unsigned int _stallCounts = 2;
+    unsigned int _stallTime = 250;
+    unsigned int _timeout = 5000;
+    State _state = Motor_Idle;
+    int _target = 0;
+    unsigned long _seekStart = 0;
+    unsigned long _seekTime = 0;
+    unsigned long _settleStart = 0;
+    int _stallPosition = 0;                             // reading at the start of the stall window
+    unsigned long _stallStart = 0;
+    boolean _tracking = false;                          // false until the first reading of a seek
+    int _lastPosition = 0;
+    unsigned long _lastTime = 0;
+    long _velocity = 0;                                 // smoothed speed in 1/64 ADC counts per ms
+    Drive _drive = Drive_Stop;                          // direction returned by the last update
+    Drive _lastMove = Drive_Stop;                       // direction of the last move before settling
+    unsigned int _band = 4;                             // deadband of the current seek, widened each time it hunts back
+
+    void _startStallWindow(int position, unsigned long now);
+};
+
+#endif
@@ -0,0 +1,88 @@
+/*
+  Volume taper lookup tables, calculated by the compiler and stored in PROGMEM.
+  Each table maps evenly spaced pot positions to a fraction (0-255) of the attenuation range,
+  position 0 being the minimum attenuation end of the pot.
+*/
+
+#ifndef DACTaper_h
+#define DACTaper_h
+#if ARDUINO >= 100
+  #include "Arduino.h"
+#else
+  #include "WProgram.h"
+  #include "pins_arduino.h"
+  #include "WConstants.h"
+#endif
+
+#ifndef DACTAPER_POINTS
+  #define DACTAPER_POINTS 65                      // breakpoints per built-in taper, interpolated linearly in between
+#endif
+
+namespace DACTaper
+{
+  // compile time helpers, C++11 constexpr functions consisting of a single return statement
+  constexpr double _position(byte i)
+  {
+    return (double)i / (DACTAPER_POINTS - 1);
+  }
+
+  constexpr byte _round(double val)
+  {
+    return (val <= 0.0) ? 0 : ((val >= 255.0) ? 255 : (byte)(val + 0.5));
+  }
+
+  constexpr double _lnSeries(double y2, double term, int k)
+  {
+    return (k > 41) ? 0.0 : term / k + _lnSeries(y2, term * y2, k + 2);
+  }
+
+  constexpr double _ln(double x)
+  {
+    // halve the argument into [0.5, 1] where the atanh series converges quickly
+    return (x < 0.5) ? _ln(x * 2.0) - 0.69314718055994531 : 2.0 * _lnSeries(((x - 1.0) / (x + 1.0)) * ((x - 1.0) / (x + 1.0)), (x - 1.0) / (x + 1.0), 1);
+  }
+
+  // attenuation in dB proportional to pot travel, i.e. the plain 0.5dB step mapping
+  struct LinearDB
+  {
+    static constexpr byte at(byte i)
+    {
+      return _round(255.0 * _position(i));
+    }
+  };
+
+  // audio (log) pot: fine steps over the top of the range, most of the travel where the volume is audible
+  struct Log
+  {
+    static constexpr double curve = 0.97;
+    static constexpr byte at(byte i)
+    {
+      return _round(255.0 * _ln(1.0 - curve * _position(i)) / _ln(1.0 - curve));
+    }
+  };
+
+  // smoothstep: fine steps at both ends of the range
+  struct SCurve
+  {
+    static constexpr byte at(byte i)
+    {
+      return _round(255.0 * _position(i) * _position(i) * (3.0 - 2.0 * _position(i)));
+    }
+  };
+
+  template<byte... I> struct Indices {};
+  template<byte N, byte... I> struct MakeIndices : MakeIndices<N - 1, N - 1, I...> {};
+  template<byte... I> struct MakeIndices<0, I...>
+  {
+    typedef Indices<I...> type;
+  };
+
+  template<class Curve, class Index = typename MakeIndices<DACTAPER_POINTS>::type> struct Table;
+  template<class Curve, byte... I> struct Table<Curve, Indices<I...> >
+  {
+    static const byte values[sizeof...(I)];
+  };
+  template<class Curve, byte... I> const byte Table<Curve, Indices<I...> >::values[sizeof...(I)] PROGMEM = {Curve::at(I)...};
+}
+
+#endif
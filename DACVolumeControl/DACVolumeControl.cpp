@@ -15,6 +15,34 @@
     pinMode(_pinMotor1, OUTPUT);
     pinMode(_pinMotor2, OUTPUT);
   };
+
+  DACVolumeControl::DACVolumeControl(DACControl* dacCtrl, DACVolumeInput* input)
+  {
+    _dacCtrl = dacCtrl;
+    _pinAnalogInput = 255;
+    _attenuation = ((int)_minAttenuation + _maxAttenuation) / 2;
+    addInput(input);
+  };
+
+  bool DACVolumeControl::addInput(DACVolumeInput* input)
+  {
+    if ((input == NULL) || (_inputCount >= DACVOLUMECONTROL_MAX_INPUTS))
+      return false;
+    _inputs[_inputCount++] = input;
+    return true;
+  };
+
+  void DACVolumeControl::setStepSize(byte val)
+  {
+    _stepSize = val;
+  };
+
+  void DACVolumeControl::setAcceleration(unsigned int slowInterval, unsigned int fastInterval, byte maxMultiplier)
+  {
+    _slowInterval = slowInterval;
+    _fastInterval = (fastInterval > slowInterval) ? slowInterval : fastInterval;
+    _maxMultiplier = (maxMultiplier == 0) ? 1 : maxMultiplier;
+  };
   
   void DACVolumeControl::loop()
   {
@@ -27,13 +55,26 @@
           if (_motorised())
           {
             // turn off volume pot
-            digitalWrite(_pinMotor1, LOW);
-            digitalWrite(_pinMotor2, LOW);
+            _driveMotor(DACMotorPot::Drive_Stop);
             _delayPot = 0;
-            Serial.println(F("potentiometer stopped"));
+            Msg::println(F("potentiometer stopped"));
           }
         }
-      _setAttenuationFromPot();
+      if (_potInput())
+        _samplePot();
+      else if (!_seeded)
+        initialise();
+      _readInputs(true);
+    }
+    else
+    {
+      _seeded = false;  // the DACs come up at their default volume, apply the pot again once they are initialised
+      _readInputs(false);
+      if (_motorPot.getState() == DACMotorPot::Motor_Seeking)
+      {
+        _motorPot.stop();
+        _driveMotor(DACMotorPot::Drive_Stop);
+      }
     }
   };
 
@@ -42,8 +83,8 @@
     if (_motorised())
       if (_dacCtrl->getPower())
       {
-        digitalWrite(_pinMotor1, LOW);
-        digitalWrite(_pinMotor2, HIGH);
+        _motorPot.stop();
+        _driveMotor(DACMotorPot::Drive_Down);
         _delayPot = 120;
         _lastPotEvent = millis();
       }
@@ -54,34 +95,252 @@
     if (_motorised())
       if (_dacCtrl->getPower())
       {
-        digitalWrite(_pinMotor1, HIGH);
-        digitalWrite(_pinMotor2, LOW);
+        _motorPot.stop();
+        _driveMotor(DACMotorPot::Drive_Up);
         _delayPot = 120;
         _lastPotEvent = millis();
       }
   };
 
+  bool DACVolumeControl::setTargetVolume(byte attenuation)
+  {
+    if (!_motorised() || !_potInput())
+      return false;
+    _delayPot = 0;
+    _motorPot.seek(_potFor(attenuation), millis());
+    return true;
+  };
+
+  DACMotorPot& DACVolumeControl::getMotorPot()
+  {
+    return _motorPot;
+  };
+
   void DACVolumeControl::initialise()
   {
-   _pot = 0;
-   _setAttenuationFromPot();
+    if (_potInput())
+      _seed();
+    else
+    {
+      _seeded = true;
+      _dacCtrl->requestAttenuation(_attenuation);
+    }
+  };
+
+  void DACVolumeControl::setAttenuationRange(byte minAttenuation, byte maxAttenuation)
+  {
+    _minAttenuation = (minAttenuation > DACCONTROL_MAX_ATTENUATION) ? DACCONTROL_MAX_ATTENUATION : minAttenuation;
+    _maxAttenuation = (maxAttenuation > DACCONTROL_MAX_ATTENUATION) ? DACCONTROL_MAX_ATTENUATION : maxAttenuation;
+    if (_seeded && _potInput())
+      _setAttenuationFromPot(true);
   };
 
-  void DACVolumeControl::_setAttenuationFromPot()
+  void DACVolumeControl::setTaper(DACVolumeControl::Taper val)
   {
-    int pot = 0;
-    for (int i = 0; i < 12; i++)
+    switch (val)
     {
-      int p = analogRead(_pinAnalogInput);
-      pot += p;  
-    
+      case Taper_Log:
+        setTaper(DACTaper::Table<DACTaper::Log>::values, DACTAPER_POINTS);
+        break;
+      case Taper_SCurve:
+        setTaper(DACTaper::Table<DACTaper::SCurve>::values, DACTAPER_POINTS);
+        break;
+      default:
+        setTaper(DACTaper::Table<DACTaper::LinearDB>::values, DACTAPER_POINTS);
+        break;
     }
-    pot = pot >> 7;
-    if (abs(_pot - pot) > 1)
+  };
+
+  void DACVolumeControl::setTaper(const byte table[], byte points)
+  {
+    if ((table == NULL) || (points < 2))
+      return;
+    _taper = table;
+    _taperPoints = points;
+    if (_seeded && _potInput())
+      _setAttenuationFromPot(true);
+  };
+
+  void DACVolumeControl::setPotFilter(byte iirShift, byte decimation, unsigned int hysteresis)
+  {
+    _iirShift = (iirShift > 8) ? 8 : iirShift;
+    _decimation = (decimation == 0) ? 1 : decimation;
+    _hysteresis = hysteresis;
+  };
+
+  int DACVolumeControl::getPotReading()
+  {
+    return (_potFiltered + 32) >> 6;
+  };
+
+  void DACVolumeControl::_samplePot()
+  {
+    // a single ADC conversion per call, the median of the last three removes spikes before the IIR smooths the noise
+    if (!_seeded)
+    {
+      _seed();
+      return;
+    }
+    _samples[_sampleIndex] = analogRead(_pinAnalogInput);
+    if (++_sampleIndex >= 3)
+      _sampleIndex = 0;
+    int a = _samples[0];
+    int b = _samples[1];
+    int c = _samples[2];
+    long median = (a > b) ? ((b > c) ? b : ((a > c) ? c : a)) : ((a > c) ? a : ((b > c) ? c : b));
+    // the median has no filter lag, which would make the motor overshoot
+    DACMotorPot::State state = _motorPot.getState();
+    if ((state == DACMotorPot::Motor_Seeking) || (state == DACMotorPot::Motor_Settling))
+    {
+      _driveMotor(_motorPot.update(median, millis()));
+      state = _motorPot.getState();
+      if (state == DACMotorPot::Motor_Stalled)
+        Msg::println(Msg::W, F("potentiometer stalled"));
+      else if (state == DACMotorPot::Motor_Timeout)
+        Msg::println(Msg::W, F("potentiometer timed out"));
+    }
+    _potFiltered += ((median << 6) - _potFiltered) >> _iirShift;
+    if (++_decimationCount < _decimation)
+      return;
+    _decimationCount = 0;
+    _setAttenuationFromPot(false);
+  };
+
+  void DACVolumeControl::_seed()
+  {
+    int pot = analogRead(_pinAnalogInput);
+    for (byte i = 0; i < 3; i++)
+      _samples[i] = pot;
+    _sampleIndex = 0;
+    _decimationCount = 0;
+    _potFiltered = (long)pot << 6;
+    _seeded = true;
+    _setAttenuationFromPot(true);
+  };
+
+  void DACVolumeControl::_setAttenuationFromPot(bool force)
+  {
+    long delta = _potFiltered - _potApplied;
+    long hysteresis = (long)_hysteresis << 6;
+    if (!force && (delta <= hysteresis) && (delta >= -hysteresis))
+      return;
+    _potApplied = _potFiltered;
+    int attenuation = _attenuationAt(getPotReading());
+    if (force || (attenuation != _attenuation))
+    {
+      _attenuation = attenuation;
+      _dacCtrl->requestAttenuation(attenuation);
+    }
+  };
+
+  int DACVolumeControl::_attenuationAt(long pot)
+  {
+    // snap to the ends so that the full range stays reachable with hysteresis
+    if (pot <= (long)_hysteresis)
+      pot = 0;
+    else if (pot >= DACVOLUMECONTROL_ADC_MAX - (long)_hysteresis)
+      pot = DACVOLUMECONTROL_ADC_MAX;
+    long span = (long)_maxAttenuation - _minAttenuation;
+    return _minAttenuation + ((long)_taperAt(pot) * span + ((span < 0) ? -127 : 127)) / 255;
+  };
+
+  int DACVolumeControl::_potFor(byte attenuation)
+  {
+    // the taper is monotonic, so binary search for the first and last reading giving attenuation and aim between them
+    int sign = (_maxAttenuation < _minAttenuation) ? -1 : 1;
+    long key = sign * (long)attenuation;
+    long low = 0;
+    long high = DACVOLUMECONTROL_ADC_MAX + 1;
+    while (low < high)
     {
-      _pot = pot;
-      _dacCtrl->setAttenuation(_pot);
+      long mid = (low + high) / 2;
+      if (sign * (long)_attenuationAt(mid) < key)
+        low = mid + 1;
+      else
+        high = mid;
     }
+    long first = low;
+    high = DACVOLUMECONTROL_ADC_MAX + 1;
+    while (low < high)
+    {
+      long mid = (low + high) / 2;
+      if (sign * (long)_attenuationAt(mid) <= key)
+        low = mid + 1;
+      else
+        high = mid;
+    }
+    long pot = (first + low - 1) / 2;
+    if (pot < 0)
+      pot = 0;
+    else if (pot > DACVOLUMECONTROL_ADC_MAX)
+      pot = DACVOLUMECONTROL_ADC_MAX;
+    return pot;
+  };
+
+  void DACVolumeControl::_driveMotor(DACMotorPot::Drive val)
+  {
+    // pin 2 high turns the pot towards lower readings, i.e. less attenuation with the default range
+    digitalWrite(_pinMotor1, (val == DACMotorPot::Drive_Up) ? HIGH : LOW);
+    digitalWrite(_pinMotor2, (val == DACMotorPot::Drive_Down) ? HIGH : LOW);
+  };
+
+  byte DACVolumeControl::_taperAt(long pot)
+  {
+    // interpolates between the two breakpoints either side of the pot position
+    long scaled = pot * (_taperPoints - 1);
+    byte i = scaled / DACVOLUMECONTROL_ADC_MAX;
+    long fraction = scaled % DACVOLUMECONTROL_ADC_MAX;
+    int a = pgm_read_byte(_taper + i);
+    if (i + 1 >= _taperPoints)
+      return a;
+    int b = pgm_read_byte(_taper + i + 1);
+    return a + ((b - a) * fraction + ((b < a) ? -(DACVOLUMECONTROL_ADC_MAX / 2) : (DACVOLUMECONTROL_ADC_MAX / 2))) / DACVOLUMECONTROL_ADC_MAX;
+  };
+
+  void DACVolumeControl::_readInputs(bool apply)
+  {
+    int steps = 0;
+    for (byte i = 0; i < _inputCount; i++)
+      steps += _inputs[i]->readSteps();
+    if ((steps == 0) || !apply)
+      return;
+    // the faster the steps arrive the larger each one gets
+    unsigned long now = millis();
+    unsigned long interval = (now - _lastStepTime) / abs(steps);
+    _lastStepTime = now;
+    long multiplier = 1;
+    if (interval <= _fastInterval)
+      multiplier = _maxMultiplier;
+    else if (interval < _slowInterval)
+      multiplier = 1 + ((long)(_maxMultiplier - 1) * (_slowInterval - interval)) / (_slowInterval - _fastInterval);
+    if (_motorised())
+    {
+      // the pot follows the motor and sets the attenuation itself
+      if (steps > 0)
+        volumeUp();
+      else
+        volumeDown();
+      return;
+    }
+    if (_potInput())
+      return;
+    long low = (_minAttenuation < _maxAttenuation) ? _minAttenuation : _maxAttenuation;
+    long high = (_minAttenuation < _maxAttenuation) ? _maxAttenuation : _minAttenuation;
+    long attenuation = _attenuation - (long)steps * multiplier * _stepSize;
+    if (attenuation < low)
+      attenuation = low;
+    else if (attenuation > high)
+      attenuation = high;
+    if (attenuation != _attenuation)
+    {
+      _attenuation = attenuation;
+      _dacCtrl->requestAttenuation(attenuation);
+    }
+  };
+
+  bool DACVolumeControl::_potInput()
+  {
+    return _pinAnalogInput != 255;
   };
 
   bool DACVolumeControl::_motorised()
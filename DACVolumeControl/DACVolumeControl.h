@@ -8,17 +8,43 @@
   #include "WConstants.h"
 #endif
 #include <DACControl.h>
+#include "DACTaper.h"
+#include "DACVolumeInput.h"
+#include "DACMotorPot.h"
+
+#ifndef DACVOLUMECONTROL_ADC_MAX
+  #if defined(ESP32)
+    #define DACVOLUMECONTROL_ADC_MAX 4095             // highest analogRead() value
+  #else
+    #define DACVOLUMECONTROL_ADC_MAX 1023
+  #endif
+#endif
+#ifndef DACVOLUMECONTROL_MAX_INPUTS
+  #define DACVOLUMECONTROL_MAX_INPUTS 2                 // encoder and IR remote inputs per volume control
+#endif
 
 class DACVolumeControl
 {
   public:
+    enum Taper{Taper_LinearDB, Taper_Log, Taper_SCurve};
 
     DACVolumeControl(DACControl* dacCtrl, byte pinAnalogInput);
     DACVolumeControl(DACControl* dacCtrl, byte pinAnalogInput, byte pinMotor1, byte pinMotor2);
+    DACVolumeControl(DACControl* dacCtrl, DACVolumeInput* input); // volume from encoder or IR steps, starting halfway along the attenuation range
+    bool addInput(DACVolumeInput* input);                 // adds a step input, which drives the motor of a motorised pot. false if DACVOLUMECONTROL_MAX_INPUTS are in use
+    void setStepSize(byte val);                           // attenuation change per step in 0.5dB units (default 2)
+    void setAcceleration(unsigned int slowInterval, unsigned int fastInterval, byte maxMultiplier); // steps closer than slowInterval ms apart are multiplied, up to maxMultiplier at fastInterval ms (default 100, 10, 4; 1 disables)
     void loop();
-    void volumeUp();
+    void volumeUp();                                     // runs the motor towards less attenuation for 120ms
     void volumeDown();
-    void initialise();
+    bool setTargetVolume(byte attenuation);              // turns a motorised pot to the position for attenuation using the pot reading as feedback. false if not motorised
+    DACMotorPot& getMotorPot();                          // tuning and state of the position control
+    void initialise();                                   // reseeds the filter from the pot and applies the attenuation
+    void setAttenuationRange(byte minAttenuation, byte maxAttenuation); // attenuation at either end of the pot (default 0 and DACCONTROL_MAX_ATTENUATION), swap to reverse the pot
+    void setTaper(DACVolumeControl::Taper val);          // curve from pot position to attenuation (default Taper_LinearDB)
+    void setTaper(const byte table[], byte points);      // user defined PROGMEM table of points (at least 2) evenly spaced breakpoints, each a fraction 0-255 of the attenuation range
+    void setPotFilter(byte iirShift, byte decimation, unsigned int hysteresis); // smoothing of 1/2^iirShift per sample, attenuation updated every decimation samples, once the reading moved more than hysteresis ADC counts
+    int getPotReading();                                 // filtered pot position in ADC counts
 
   private: 
 
@@ -26,11 +52,40 @@ class DACVolumeControl
     byte _pinMotor1 = 255;
     byte _pinMotor2 = 255;
     byte _pinAnalogInput;
-    int _pot = 0;
+    byte _minAttenuation = 0;
+    byte _maxAttenuation = DACCONTROL_MAX_ATTENUATION;
+    const byte *_taper = DACTaper::Table<DACTaper::LinearDB>::values; // PROGMEM
+    byte _taperPoints = DACTAPER_POINTS;
+    int _samples[3];                                     // last three ADC samples for the median filter
+    byte _sampleIndex = 0;
+    boolean _seeded = false;                             // false until the filter holds a reading
+    long _potFiltered = 0;                               // IIR filter output in 1/64 ADC counts
+    long _potApplied = 0;                                // filter output the attenuation was last calculated from
+    byte _iirShift = 3;
+    byte _decimation = 4;
+    byte _decimationCount = 0;
+    unsigned int _hysteresis = 3;
+    int _attenuation = -1;                               // attenuation last set, -1 if none
+    DACVolumeInput* _inputs[DACVOLUMECONTROL_MAX_INPUTS];
+    byte _inputCount = 0;
+    byte _stepSize = 2;
+    unsigned int _slowInterval = 100;
+    unsigned int _fastInterval = 10;
+    byte _maxMultiplier = 4;
+    unsigned long _lastStepTime = 0;                     // last time a step input moved
     unsigned int _delayPot = 0;                          // delay before turning potentiometer motor off
     unsigned long _lastPotEvent = 0;                     // last time volume pot changed
+    DACMotorPot _motorPot;
 
-    void _setAttenuationFromPot();
+    void _samplePot();
+    void _seed();
+    void _setAttenuationFromPot(bool force);
+    void _readInputs(bool apply);
+    bool _potInput();
+    byte _taperAt(long pot);
+    int _attenuationAt(long pot);
+    int _potFor(byte attenuation);
+    void _driveMotor(DACMotorPot::Drive val);
     bool _motorised();
 };
 
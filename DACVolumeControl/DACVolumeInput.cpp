@@ -0,0 +1,200 @@
+#include <DACVolumeInput.h>
+
+int DACVolumeInput::readSteps()
+{
+  // each counter has a single writer, so the difference to the last read values is consistent without locking
+  byte up = __atomic_load_n(&_up, __ATOMIC_ACQUIRE);
+  byte down = __atomic_load_n(&_down, __ATOMIC_ACQUIRE);
+  int steps = (int)(byte)(up - _upRead) - (int)(byte)(down - _downRead);
+  _upRead = up;
+  _downRead = down;
+  return steps;
+}
+
+DACEncoder *DACEncoder::_instance = NULL;
+
+DACEncoder::DACEncoder(byte pinA, byte pinB, byte stepsPerDetent)
+{
+  _pinA = pinA;
+  _pinB = pinB;
+  _stepsPerDetent = (stepsPerDetent == 0) ? 1 : stepsPerDetent;
+}
+
+void DACEncoder::begin()
+{
+  pinMode(_pinA, INPUT_PULLUP);
+  pinMode(_pinB, INPUT_PULLUP);
+  _state = (digitalRead(_pinA) << 1) | digitalRead(_pinB);
+  _instance = this;
+  attachInterrupt(digitalPinToInterrupt(_pinA), _isr, CHANGE);
+  attachInterrupt(digitalPinToInterrupt(_pinB), _isr, CHANGE);
+}
+
+void DACVOLUMEINPUT_ISR DACEncoder::_isr()
+{
+  DACEncoder *enc = _instance;
+  // previous and current pin states index the quadrature transition table, held as bit masks so the ISR reads no table
+  byte state = ((enc->_state << 2) | (digitalRead(enc->_pinA) << 1) | digitalRead(enc->_pinB)) & 0x0F;
+  enc->_state = state;
+  signed char transitions = enc->_transitions;
+  if ((0x2814 >> state) & 1)
+    transitions++;
+  else if ((0x4182 >> state) & 1)
+    transitions--;
+  if (transitions >= (signed char)enc->_stepsPerDetent)
+  {
+    transitions = 0;
+    enc->_up = enc->_up + 1;
+  }
+  else if (transitions <= -(signed char)enc->_stepsPerDetent)
+  {
+    transitions = 0;
+    enc->_down = enc->_down + 1;
+  }
+  enc->_transitions = transitions;
+}
+
+DACIRRemote *DACIRRemote::_instance = NULL;
+
+DACIRRemote::DACIRRemote(byte pin, DACIRRemote::Protocol protocol, unsigned long upCode, unsigned long downCode)
+{
+  _pin = pin;
+  _protocol = protocol;
+  _upCode = upCode;
+  _downCode = downCode;
+}
+
+void DACIRRemote::begin()
+{
+  pinMode(_pin, INPUT);
+  _instance = this;
+  // NEC encodes the bits in the time between falling edges, RC5 needs both edges for its Manchester coding
+  attachInterrupt(digitalPinToInterrupt(_pin), _isr, (_protocol == NEC) ? FALLING : CHANGE);
+}
+
+unsigned long DACIRRemote::getLastCode()
+{
+  noInterrupts();
+  unsigned long code = _lastCode;
+  interrupts();
+  return code;
+}
+
+void DACVOLUMEINPUT_ISR DACIRRemote::_isr()
+{
+  DACIRRemote *ir = _instance;
+  unsigned long now = micros();
+  unsigned long interval = now - ir->_lastEdge;
+  ir->_lastEdge = now;
+  if (ir->_protocol == NEC)
+    ir->_edgeNEC(now, interval);
+  else
+    ir->_edgeRC5(now, interval);
+}
+
+void DACVOLUMEINPUT_ISR DACIRRemote::_edgeNEC(unsigned long now, unsigned long interval)
+{
+  if ((interval > 12500) && (interval < 14500))
+  {
+    // 9ms burst and 4.5ms space start a frame
+    _code = 0;
+    _bits = 0;
+    _receiving = true;
+  }
+  else if ((interval > 10500) && (interval < 12500))
+  {
+    // 9ms burst and 2.25ms space: the key is still held, repeats arrive every 108ms
+    _receiving = false;
+    if ((_repeat != 0) && (now - _lastKey < 150000UL))
+    {
+      _lastKey = now;
+      if (_repeat > 0)
+        _up = _up + 1;
+      else
+        _down = _down + 1;
+    }
+  }
+  else if (_receiving)
+  {
+    // bits are sent LSB first, 1.125ms for a 0 and 2.25ms for a 1
+    if ((interval > 900) && (interval < 1400))
+      _bits = _bits + 1;
+    else if ((interval > 1900) && (interval < 2600))
+    {
+      _code = _code | (1UL << _bits);
+      _bits = _bits + 1;
+    }
+    else
+      _receiving = false;
+    if (_bits == 32)
+    {
+      _receiving = false;
+      _key(_code, now);
+    }
+  }
+}
+
+void DACVOLUMEINPUT_ISR DACIRRemote::_edgeRC5(unsigned long now, unsigned long interval)
+{
+  // Manchester decoding state machine: start of a 1, middle of a 1, middle of a 0, start of a 0
+  enum RC5State{RC5_Start1, RC5_Mid1, RC5_Mid0, RC5_Start0};
+  bool level = digitalRead(_pin);
+  byte event = 0;
+  if ((interval >= 444) && (interval <= 1333))
+    event = 0;                                      // half bit
+  else if ((interval > 1333) && (interval <= 2222))
+    event = 4;                                      // full bit
+  else
+    _receiving = false;
+  if (!_receiving)
+  {
+    // the carrier switching on is the middle of the first start bit
+    if (!level)
+    {
+      _receiving = true;
+      _rc5State = RC5_Mid1;
+      _code = 1;
+      _bits = 1;
+    }
+    return;
+  }
+  if (level)
+    event += 2;                                     // the interval that ended had the carrier on
+  // next state for each event, two bits per event: half space, half pulse, full space, full pulse
+  byte state = ((0xFB9B9101UL >> (_rc5State * 8)) >> event) & 3;
+  if (state == _rc5State)
+  {
+    _receiving = false;                             // not a valid transition
+    return;
+  }
+  _rc5State = state;
+  if ((state == RC5_Mid0) || (state == RC5_Mid1))
+  {
+    _code = (_code << 1) | ((state == RC5_Mid1) ? 1 : 0);
+    _bits = _bits + 1;
+    if (_bits == 14)
+    {
+      // 2 start bits, toggle bit, 5 address bits and 6 command bits. Held keys resend the frame every 114ms
+      _receiving = false;
+      _key(_code & 0x7FF, now);
+    }
+  }
+}
+
+void DACVOLUMEINPUT_ISR DACIRRemote::_key(unsigned long code, unsigned long now)
+{
+  _lastCode = code;
+  _lastKey = now;
+  if (code == _upCode)
+  {
+    _repeat = 1;
+    _up = _up + 1;
+  }
+  else if (code == _downCode)
+  {
+    _repeat = -1;
+    _down = _down + 1;
+  }
+  else
+    _repeat = 0;
+}
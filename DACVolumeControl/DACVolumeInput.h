@@ -0,0 +1,83 @@
+/*
+  Interrupt driven volume inputs for DACVolumeControl: a quadrature rotary encoder and an NEC or RC5 IR remote.
+  The ISRs only count steps, DACVolumeControl collects them from loop() without disabling interrupts.
+*/
+
+#ifndef DACVolumeInput_h
+#define DACVolumeInput_h
+#if ARDUINO >= 100
+  #include "Arduino.h"
+#else
+  #include "WProgram.h"
+  #include "pins_arduino.h"
+  #include "WConstants.h"
+#endif
+
+#if defined(ESP8266) || defined(ESP32)
+  #define DACVOLUMEINPUT_ISR IRAM_ATTR
+#else
+  #define DACVOLUMEINPUT_ISR
+#endif
+
+class DACVolumeInput
+{
+  public:
+    int readSteps();                                    // net volume steps since the last call, positive is volume up
+
+  protected:
+    volatile byte _up = 0;                              // free running step counters, only ever incremented by the ISR
+    volatile byte _down = 0;
+    byte _upRead = 0;                                   // counter values at the last readSteps()
+    byte _downRead = 0;
+};
+
+// one encoder per sketch, both pins must support interrupts
+class DACEncoder : public DACVolumeInput
+{
+  public:
+    DACEncoder(byte pinA, byte pinB, byte stepsPerDetent = 4); // swap the pins to reverse the direction
+    void begin();
+
+  private:
+    byte _pinA;
+    byte _pinB;
+    byte _stepsPerDetent;
+    volatile byte _state = 0;                           // last two pin states
+    volatile signed char _transitions = 0;              // transitions since the last detent
+
+    static DACEncoder *_instance;
+    static void _isr();
+};
+
+// one remote per sketch, pin is the output of a demodulating IR receiver (low while the carrier is on)
+class DACIRRemote : public DACVolumeInput
+{
+  public:
+    enum Protocol{NEC, RC5};
+
+    DACIRRemote(byte pin, DACIRRemote::Protocol protocol, unsigned long upCode, unsigned long downCode); // NEC: 32 bit frame, RC5: address << 6 | command
+    void begin();
+    unsigned long getLastCode();                        // last frame received, to find the codes of a remote
+
+  private:
+    byte _pin;
+    Protocol _protocol;
+    unsigned long _upCode;
+    unsigned long _downCode;
+    volatile unsigned long _lastCode = 0;
+    volatile unsigned long _lastEdge = 0;               // micros() of the previous edge
+    volatile unsigned long _lastKey = 0;                // micros() of the last volume key frame or repeat
+    volatile unsigned long _code = 0;                   // frame being received
+    volatile byte _bits = 0;
+    volatile boolean _receiving = false;
+    volatile byte _rc5State = 0;
+    volatile signed char _repeat = 0;                   // direction an NEC repeat frame steps in, 0 if the last key was not a volume key
+
+    static DACIRRemote *_instance;
+    static void _isr();
+    void _edgeNEC(unsigned long now, unsigned long interval);
+    void _edgeRC5(unsigned long now, unsigned long interval);
+    void _key(unsigned long code, unsigned long now);
+};
+
+#endif
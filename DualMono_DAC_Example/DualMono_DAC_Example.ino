@@ -1,6 +1,7 @@
 #include <ES9028.h>
 #include <DACControl.h>
 #include <DACVolumeControl.h>
+#include <DACScheduler.h>
 
 /*
   Initialises 2 Sabre32 ES9028/38 DACs in 24 bit dual mono operation using the Hybrid filter,
@@ -23,6 +24,13 @@ DACControl dacCtrl = DACControl(es9028dacs, NO_OF_ES9028_DACS, 40000);
 DACVolumeControl dacVolCtrl = DACVolumeControl(&dacCtrl, VOL_ANALOG_INPUT_PIN);
 // specify pins for motorised pot
 //DACVolumeControl dacVolCtrl = DACVolumeControl(&dacCtrl, VOL_ANALOG_INPUT_PIN);
+// or a rotary encoder on interrupt pins 2 and 3, call encoder.begin() in setup()
+//DACEncoder encoder = DACEncoder(2, 3);
+//DACVolumeControl dacVolCtrl = DACVolumeControl(&dacCtrl, &encoder);
+// an NEC remote can be added to any of them with dacVolCtrl.addInput(&remote), print remote.getLastCode() to find the key codes
+//DACIRRemote remote = DACIRRemote(7, DACIRRemote::NEC, 0xF609FF00, 0xE31CFF00);
+// a motorised pot can also be turned to an exact attenuation, e.g. dacVolCtrl.setTargetVolume(60) for -30dB
+DACScheduler scheduler;
 
 bool configDAC(ES9028* dac)
 {
@@ -53,6 +61,16 @@ void eventNoLock()
   digitalWrite(LED_BUILTIN, false);   // turn the LED off if either DAC not locked
 }
 
+void dacTask()
+{
+  dacCtrl.loop();
+}
+
+void volumeTask()
+{
+  dacVolCtrl.loop();
+}
+
 void setup() {
   // initialize digital pin LED_BUILTIN as the DAC lock light.
   pinMode(LED_BUILTIN, OUTPUT);
@@ -62,6 +80,16 @@ void setup() {
   dacCtrl.onLock(eventLocked);
   dacCtrl.onNoLock(eventNoLock);
 
+  // restore the last known good DAC configuration from EEPROM at power on (change the id whenever configDAC changes)
+  // dacCtrl.enableConfigCache(1);
+
+  // keep a status history (declare DACHistory history; globally) and dump it with history.printCSV(Serial) after a dropout
+  // dacCtrl.recordHistory(history);
+
+  // switch filter settings automatically with the incoming signal
+  // dacCtrl.setRateProfile(DACControl::Rate_PCM48k, ES9028::Filter_Apodizing, ES9028::IIR_4744k, ES9028::DPLL_Default, ES9028::DPLL_Default);
+  // dacCtrl.setRateProfile(DACControl::Rate_DSD, ES9028::Filter_FastLinPhase, ES9028::IIR_50k, ES9028::DPLL_Default, ES9028::DPLL_Lower);
+
   // customise I2C pins when using ESP8266
   // dacCtrl.setPinSDA(4);
   // dacCtrl.setPinSCL(5);
@@ -75,11 +103,20 @@ void setup() {
   //   dacCtrl.onAfterPowerOn(eventAfterPowerOn);
   //   dacCtrl.onLockReadError(eventLockReadError);
   //   dacCtrl.onAutomuteStatusChanged(eventAutomuteStatusChanged);
+  // or subscribe to typed events carrying their payload (see DACEvents.h), e.g. void onDACEvent(const DACEvent &event)
+  //   dacCtrl.subscribe(onDACEvent);
   dacCtrl.powerOn();
+
+  // an audio taper puts most of the pot travel where the volume is audible
+  // dacVolCtrl.setTaper(DACVolumeControl::Taper_Log);
+  // let the DACs ramp between the volume steps written each loop, dacCtrl.getMaxVolumeLatency() shows the knob lag
+  // dacCtrl.setVolumeRamp(4);
+
+  // volume runs first whenever both are due, use scheduler.printStats() to check for overruns
+  scheduler.addTask(volumeTask, 10, 1, 0, 2000, "volume");
+  scheduler.addTask(dacTask, 10, 0, 0, 0, "dac");
 }
 
 void loop() {
-  dacCtrl.loop();
-  dacVolCtrl.loop();
-  delay(10);
+  scheduler.loop();
 }
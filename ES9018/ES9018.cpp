@@ -1,16 +1,14 @@
 #include "ES9018.h"
 
 
-ES9018::ES9018(String name, Clock value)
+ES9018::ES9018(DACChip::Name name, Clock value) : DACChip(name)
 {
-  _name = name;
-  _clock = value;       
+  _setClock(value);
 }
 
-ES9018::ES9018(String name, Clock value, Mode mode)
+ES9018::ES9018(DACChip::Name name, Clock value, Mode mode) : DACChip(name)
 {
-  _name = name;
-  _clock = value;       
+  _setClock(value);
   if (mode == MonoRight)
   {
     _address = 0x49; // set default I2C address for mono right config
@@ -21,28 +19,61 @@ ES9018::ES9018(String name, Clock value, Mode mode)
   _setMode(mode);
 }
 
-ES9018::ES9018(String name, Clock value, Mode mode, Phase oddChannels, Phase evenChannels)
+ES9018::ES9018(DACChip::Name name, Clock value, Mode mode, Phase oddChannels, Phase evenChannels) : DACChip(name)
 {
-  _name = name;
-  _clock = value;       
+  _setClock(value);
   if (mode == MonoRight)
     _address = 0x49; // set default I2C address for mono right config
   _setMode(mode);
   _setPhase(oddChannels, evenChannels);
 }
 
-ES9018::ES9018(String name, Clock value, Mode mode, Phase oddChannels, Phase evenChannels, byte address)
+ES9018::ES9018(DACChip::Name name, Clock value, Mode mode, Phase oddChannels, Phase evenChannels, byte address) : DACChip(name)
 {
-  _name = name;
-  _clock = value;       
+  _setClock(value);
   _address = address;
   _setMode(mode);
   _setPhase(oddChannels, evenChannels);
 }
 
-String ES9018::getName()
+ES9018::ES9018(DACChip::Name name, Clock value, Mode mode, Phase oddChannels, Phase evenChannels, byte address, TwoWire &wire) : DACChip(name)
 {
-  return _name;
+  _setClock(value);
+  _address = address;
+  _wire = &wire;
+  _setMode(mode);
+  _setPhase(oddChannels, evenChannels);
+}
+
+void ES9018::_setClock(Clock value)
+{
+  _clock = value;
+  _rateEstimate.setMCLK((value == Clock80Mhz) ? 80000000UL : 100000000UL);
+}
+
+void ES9018::setMCLK(unsigned long val)
+{
+  _rateEstimate.setMCLK(val);
+}
+
+const SampleRate& ES9018::getRateEstimate()
+{
+  return _rateEstimate;
+}
+
+bool ES9018::probe(byte &chipId)
+{
+  chipId = 0;
+  if (noI2C)
+    return true;
+  _wire->beginTransmission(_address); 
+  _wire->write(27);
+  if (_wire->endTransmission() != 0)
+    return false;
+  if (_wire->requestFrom(_address, 1) == 0)
+    return false;
+  _wire->read();
+  return true;
 }
 
 boolean ES9018::initialise()
@@ -66,9 +97,28 @@ boolean ES9018::initialise()
   return false;
 }
 
-void ES9018::reset()
+bool ES9018::reset()
 {
   _setInitialised(false);
+  return true;
+}
+
+bool ES9018::readStatus(bool &lockStatus, bool &automuteStatus)
+{
+  bool readError;
+  lockStatus = locked(readError);
+  automuteStatus = false;
+  return !readError;
+}
+
+bool ES9018::selectSource(DACChip::Source val)
+{
+  return setInputSelect((val == Source_SPDIF) ? SPDIF : I2SorDSD);
+}
+
+bool ES9018::setMasterAttenuation(byte val)
+{
+  return setAttenuation(val);
 }
 
 bool ES9018::getInitialised()
@@ -79,9 +129,12 @@ bool ES9018::getInitialised()
 void ES9018::_printDAC()
 {
   Serial.print(F("->"));
-  Serial.print(_name);
+  if (_name.inFlash)
+    Serial.print((const __FlashStringHelper *) _name.text);
+  else
+    Serial.print(_name.text);
   Serial.print(F(" [ES9018 @"));
-  Serial.print(String(_address, HEX));
+  Serial.print(_address, HEX);
   Serial.print(F("]: "));
 }
 
@@ -105,6 +158,16 @@ byte ES9018::getAddress()
   return _address;
 }
 
+TwoWire* ES9018::getWire()
+{
+  return _wire;
+}
+
+void ES9018::setWire(TwoWire &wire)
+{
+  _wire = &wire;
+}
+
 bool ES9018::locked()
 {
   bool l;
@@ -156,7 +219,7 @@ bool ES9018::mute()
 {
   _printDAC();
   Serial.println(F("muting"));
-  bool result = _writeRegisterBits(10,"*******1");              // Set bit zero for reg 10: Mute DACs
+  bool result = _writeRegisterBits(10, F("*******1"));              // Set bit zero for reg 10: Mute DACs
   return result;
 }
 
@@ -164,7 +227,7 @@ bool ES9018::unmute()
 {
   _printDAC();
   Serial.println(F("unmuting"));
-  bool result = _writeRegisterBits(10,"*******0");            // Clear bit zero for reg 10: UnMute DACs
+  bool result = _writeRegisterBits(10, F("*******0"));            // Clear bit zero for reg 10: UnMute DACs
   return result;
 }
 
@@ -183,16 +246,12 @@ READING THE SAMPLE RATE
  significant digits is 44,105 Hz (the 5 Hz deviation from ideal 44100 Hz is within the specification
  of SPDIF and the tolerances of the crystals and clocks involved)
  
- In order to increase the accuracy of the integer calculation, we can use more of the significant 
- digits of the divisor. I did some evaluation of the DPLL register values for sample rates ranging 
- from 44.1K to 192K and noticed that I could multiply the value of the DPLL number by up to 
- 400 without overflowing the 32-bits. Therefore, since we have 32 bit number to work with, we 
- can multiply the DPLL number by 400 and then divide by 400X53.687091=21475. If we do this, 
- we obtain 44.105K which is the same as the exact value.
+ Instead of dividing by a rounded constant for one crystal frequency, SampleRate multiplies the 
+ DPLL number by the MCLK frequency into a 64-bit fixed point number and shifts out the 2^32, which 
+ keeps every significant digit for any MCLK and also snaps the result to the standard rates.
  
  For I2S input the dpll number is divided by (2^32*64/Crystal-Frequency) Note the 64 factor.
- The value of this is 3435.97 which rounds off nicely to 3436 (which is only 0.0008% error). The
- resultant value for the sample rate is the same whether in spdif or I2S mode.
+ The resultant value for the sample rate is the same whether in spdif or I2S mode.
  */
 
 unsigned long ES9018::sampleRate() 
@@ -213,19 +272,9 @@ unsigned long ES9018::sampleRate()
   DPLLNum|=val;
   bool spdif;
   validSPDIF(spdif);
-  if (spdif) // SPDIF signal
-  {
-    DPLLNum*=400;    // Calculate SR for SPDIF (part 1)
-    DPLLNum/=21475;  // Calculate SR for SDPIF (part 2)
-  }
-  else 
-  {
-    if (_clock == Clock80Mhz)
-      DPLLNum/=3436;   // Calculate SR for I2S 80MHz clock
-    else
-      DPLLNum/=2749;   // Calculate SR for I2S 100MHz clock
-  }
-  return DPLLNum;
+  // SPDIF: FSR = DPLL number * MCLK / 2^32, I2S: FSR = DPLL number * MCLK / (2^32 * 64)
+  _rateEstimate.measure(DPLLNum, false, spdif ? 0 : 6);
+  return _rateEstimate.getRate();
 }
 
 bool ES9018::_readRegister(byte regAddr, byte &regVal) 
@@ -234,36 +283,36 @@ bool ES9018::_readRegister(byte regAddr, byte &regVal)
   {
     _printDAC();
     Serial.print(F("Uninitialised Error reading status register "));
-    Serial.println(String(regAddr));
+    Serial.println(regAddr);
     return false;
   }
   if (noI2C)
     return true;
-  Wire.beginTransmission(_address); 
-  Wire.write(regAddr);
+  _wire->beginTransmission(_address); 
+  _wire->write(regAddr);
   byte result;           
-  result = Wire.endTransmission();
+  result = _wire->endTransmission();
   if (result == 0) // success
   {
-    Wire.requestFrom(_address, 1); // request one byte from address
+    _wire->requestFrom(_address, 1); // request one byte from address
     unsigned long retryUntil = millis() + _readRetryInterval;
-    while (!Wire.available())
+    while (!_wire->available())
     {
       if (millis() > retryUntil)
       {
         _printDAC();
         Serial.print(F("timeout reading status register "));
-        Serial.println(String(regAddr));
+        Serial.println(regAddr);
         return false;
       }
     }
-    regVal = Wire.read();         // Return the value returned by specified register
+    regVal = _wire->read();         // Return the value returned by specified register
 /*    
     _printDAC();
     Serial.print(F("read value "));
-    Serial.print(String(regVal, BIN));
+    Serial.print(regVal, BIN);
     Serial.print(F(" from register "));
-    Serial.println(String(regAddr));
+    Serial.println(regAddr);
 */
     return true;
   }
@@ -271,28 +320,28 @@ bool ES9018::_readRegister(byte regAddr, byte &regVal)
   {
     _printDAC();
     Serial.print(F("Error reading status register "));
-    Serial.print(String(regAddr));
+    Serial.print(regAddr);
     Serial.println(F(" - data too long to fit in transmit buffer"));
   }
   else if (result == 2)
   {
     _printDAC();
     Serial.print(F("Error reading status register "));
-    Serial.print(String(regAddr));
+    Serial.print(regAddr);
     Serial.println(F(" - received NACK on transmit of address"));
   }
   else if (result == 3)
   {
     _printDAC();
     Serial.print(F("Error reading status register "));
-    Serial.print(String(regAddr));
+    Serial.print(regAddr);
     Serial.println(F(" - received NACK on transmit of data"));
   }
   else if (result == 3)
   {
     _printDAC();
     Serial.print(F("Error reading status register "));
-    Serial.print(String(regAddr));
+    Serial.print(regAddr);
     Serial.println(F(" - received unspecified error"));
   }
   return false;
@@ -304,16 +353,16 @@ bool ES9018::_writeRegister(byte regAddr, byte regVal)
   {
     _printDAC();
     Serial.print(F("Uninitialised Error writing status register "));
-    Serial.println(String(regAddr));
+    Serial.println(regAddr);
     return false;
   }
   if (noI2C)
     return true;
   _printDAC();
   Serial.print(F("Writing "));
-  Serial.print(String(regVal, BIN));
+  Serial.print(regVal, BIN);
   Serial.print(F(" to register "));
-  Serial.println(String(regAddr));
+  Serial.println(regAddr);
   byte readVal;
   bool readOk = _readRegister(regAddr, readVal);
   if (!readOk)
@@ -327,16 +376,16 @@ bool ES9018::_writeRegister(byte regAddr, byte regVal)
       Serial.println(F("-Write value same as register value- "));
     else
     {
-      Wire.beginTransmission(_address); 
-      Wire.write(regAddr);               // Specifying the address of register
-      int result = Wire.write(regVal);   // Writing the value into the register
-      Wire.endTransmission();
+      _wire->beginTransmission(_address); 
+      _wire->write(regAddr);               // Specifying the address of register
+      int result = _wire->write(regVal);   // Writing the value into the register
+      _wire->endTransmission();
       readOk = _readRegister(regAddr, readVal); // confirm write
       if (!readOk)
       {
         Serial.print(F("-Write Error- "));
         Serial.print(F(" could not read written value from register "));
-        Serial.println(String(regAddr));
+        Serial.println(regAddr);
         return false;
       }
       else
@@ -344,9 +393,9 @@ bool ES9018::_writeRegister(byte regAddr, byte regVal)
         if (readVal != regVal)
         {
           Serial.print(F("-Write Error- "));
-          Serial.print(String(readVal, BIN));
+          Serial.print(readVal, BIN);
           Serial.print(F(" read from register "));
-          Serial.println(String(regAddr));
+          Serial.println(regAddr);
           return false;
         }
         else
@@ -357,10 +406,11 @@ bool ES9018::_writeRegister(byte regAddr, byte regVal)
   return true;
 }
 
-boolean ES9018::_changeByte(byte &val, String bits)
+boolean ES9018::_changeByte(byte &val, const __FlashStringHelper *bits)
 {
   boolean result = false;
-  int l = bits.length();
+  const char *p = (const char *) bits;
+  int l = strlen_P(p);
   if (l != 8)
   {
     Serial.print(F("changebits: "));
@@ -369,7 +419,7 @@ boolean ES9018::_changeByte(byte &val, String bits)
   }
   for (int i=0; i<l; i++)
   {
-    char c = bits.charAt(i);
+    char c = pgm_read_byte(p + i);
     int x = bitRead(val, 7-i);
     switch (c) 
     {
@@ -400,7 +450,7 @@ boolean ES9018::_changeByte(byte &val, String bits)
   return result;
 }
 
-bool ES9018::_writeRegisterBits(byte regAddr, String bits) 
+bool ES9018::_writeRegisterBits(byte regAddr, const __FlashStringHelper *bits) 
 {
   byte regVal;
   bool ok = _readRegister(regAddr, regVal);
@@ -653,9 +703,9 @@ bool ES9018::setDPLL128Mode(DPLL128Mode mode)
   _printDAC();
   Serial.println(F("setting DPLL 128 mode"));
   if (mode == UseDPLLSetting)
-    return _writeRegisterBits(25, "*******0");  // Reg 25 DPLL128x: Use DPLL setting (D)
+    return _writeRegisterBits(25, F("*******0"));  // Reg 25 DPLL128x: Use DPLL setting (D)
   else
-    return _writeRegisterBits(25, "*******1");  // Reg 25 DPLL128x: Multiply DPLL by 128
+    return _writeRegisterBits(25, F("*******1"));  // Reg 25 DPLL128x: Multiply DPLL by 128
 }
 
 bool ES9018::setInputSelect(InputSelect mode)
@@ -663,9 +713,9 @@ bool ES9018::setInputSelect(InputSelect mode)
   _printDAC();
   Serial.println(F("setting input select"));
   if (mode == I2SorDSD)
-    return _writeRegisterBits(8, "0*******");  // Reg 8 : Use I2S or DSD (D)
+    return _writeRegisterBits(8, F("0*******"));  // Reg 8 : Use I2S or DSD (D)
   else
-    return _writeRegisterBits(8, "1*******");  // Reg 8 : Use SPDIF
+    return _writeRegisterBits(8, F("1*******"));  // Reg 8 : Use SPDIF
 }
 
 void ES9018::_setMode(Mode mode)
@@ -8,9 +8,14 @@
   All DAC registry writes can be viewed via the Arduino's serial monitor
 
   (see the WIRE library for details on connecting an I2C device to an Arduino board. Be aware that most I2C devices use 3.3 volts!)
+
+  The library does not allocate from the heap. On AVR each instance uses 42 bytes of RAM: 6 for the DACChip base (vtable
+  pointer, name pointer and flags) and 36 for the settings, 22 of them the sample rate estimate.
 */
 
 #include <Wire.h>
+#include <SampleRate.h>
+#include <DACChip.h>
 
 #ifndef ES9018_h
 #define ES9018_h
@@ -22,7 +27,7 @@
   #include "WConstants.h"
 #endif
 
-class ES9018 
+class ES9018 : public DACChip
 {
   public:
     enum Mode{MonoLeft, MonoRight, Stereo, EightChannel};
@@ -41,27 +46,35 @@ class ES9018
     enum SPDIFMode{SPDIF_Auto, SPDIF_Manual};
 
     // default to 8 channel mode with default phase settings and default I2C address 0x48
-    ES9018(String name, Clock value);  
+    ES9018(DACChip::Name name, Clock value);  
     // specify mode with default phase settings and default I2C address 0x49 for right mono and 0x48 otherwise
-    ES9018(String name, Clock value, Mode mode);  
+    ES9018(DACChip::Name name, Clock value, Mode mode);  
     // specify whether 8 channel, stereo, or mono left/right and channel phase with default I2C address 0x49 for right mono and 0x48 otherwise
-    ES9018(String name, Clock value, Mode mode, Phase oddChannels, Phase evenChannels);   
+    ES9018(DACChip::Name name, Clock value, Mode mode, Phase oddChannels, Phase evenChannels);   
     // specify whether 8 channel, stereo, or mono left/right, channel phase and custom I2C address
-    ES9018(String name, Clock value, Mode mode, Phase oddChannels, Phase evenChannels, byte address); 
+    ES9018(DACChip::Name name, Clock value, Mode mode, Phase oddChannels, Phase evenChannels, byte address); 
+    // as above for a DAC on an I2C bus other than Wire (e.g. Wire1 on the ESP32)
+    ES9018(DACChip::Name name, Clock value, Mode mode, Phase oddChannels, Phase evenChannels, byte address, TwoWire &wire); 
 
-    bool noI2C = false;
     bool initialise();                                     //  writes all register values for the first time. After an init() any further register changes are written immediately
+    bool probe(byte &chipId);                              //  quietly checks the DAC answers before initialisation (the ES9018 has no chip ID, so chipId is always 0)
     bool getInitialised();
-    void reset();
+    bool reset();
     bool validSPDIF(bool &status);
     ES9018::Mode getMode();
     bool locked();
     bool locked(bool &readError);
+    bool readStatus(bool &lockStatus, bool &automuteStatus); // DACChip interface: lock, automute is not reported by the ES9018
+    bool selectSource(DACChip::Source val);          // DACChip interface: SPDIF or the shared I2S/DSD input
+    bool setMasterAttenuation(byte val);             // DACChip interface: setAttenuation()
     byte getAddress();                               // returns the I2C address
-    String getName();
+    TwoWire* getWire();                              // returns the I2C bus the DAC is connected to
+    void setWire(TwoWire &wire);                     // sets the I2C bus the DAC is connected to (defaults to Wire)
     bool mute();
     bool unmute();
-    unsigned long sampleRate();
+    unsigned long sampleRate();                      // returns the measured sample rate in Hz
+    void setMCLK(unsigned long val);                 // MCLK frequency in Hz if neither 80MHz nor 100MHz
+    const SampleRate& getRateEstimate();             // details of the last sample rate measurement (nominal rate, family, ppm error)
     bool setAttenuation(byte attenuation);
     bool setAutoMuteLevel(byte level);
     bool setBypassOSF(boolean value);
@@ -83,10 +96,11 @@ class ES9018
 
   private:
     bool _locked(bool &status);
-    String _name;
     Mode _mode = EightChannel;   // default to eight channel mode
     byte _address = 0x48;           // set default I2C address
+    TwoWire *_wire = &Wire;         // I2C bus the DAC is connected to
     Clock _clock = Clock100Mhz;  // set default clock speed to 100Mhz
+    SampleRate _rateEstimate;       // MCLK and last sample rate measurement
     bool _initialised = false;
     const int _readRetryInterval = 20;    // _readRegister retry interval
     Phase _oddChannels = InPhase;
@@ -250,11 +264,12 @@ class ES9018
 
     boolean _readRegister(byte regAddr, byte &regVal); 
     bool _writeRegister(byte regAddr, byte regVal);             // writes the specified register value to the specified DAC register via I2C
-    boolean _writeRegisterBits(byte regAddr, String bits); 
-    boolean _changeByte(byte &val, String bits);
+    boolean _writeRegisterBits(byte regAddr, const __FlashStringHelper *bits); 
+    boolean _changeByte(byte &val, const __FlashStringHelper *bits);
     boolean _writeMode();
     boolean _writePhase();
     void _setMode(Mode mode);
+    void _setClock(Clock value);
     void _setPhase(Phase oddChannels, Phase evenChannels);
     void _setInitialised(boolean val);
     void _printDAC();
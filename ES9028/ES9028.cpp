@@ -1,32 +1,45 @@
 #include "ES9028.h"
 
-ES9028::ES9028(String name)
+// master trim for 0 to 0.95dB of attenuation in 0.05dB steps: 0x7FFFFFFF * 10^(-step / 400)
+static const unsigned long _fineTrim[ES9028::FineSteps] PROGMEM = {
+  0x7FFFFFFF, 0x7F43EA02, 0x7E88E865, 0x7DCEF993, 0x7D161BF7, 0x7C5E4E01, 0x7BA78E21, 0x7AF1DACA, 0x7A3D3271, 0x7989938F,
+  0x78D6FC9E, 0x78256C18, 0x7774E07D, 0x76C5584E, 0x7616D20D, 0x75694C3F, 0x74BCC56B, 0x74113C1B, 0x7366AEDB, 0x72BD1C37};
+
+ES9028::ES9028(DACChip::Name name) : DACChip(name)
 {
-  _name = name;
 }
 
-ES9028::ES9028(String name, Mode mode)
+ES9028::ES9028(DACChip::Name name, Mode mode) : DACChip(name)
 {
-  _name = name;
   _mode = mode;
 }
 
-ES9028::ES9028(String name, byte addr)
+ES9028::ES9028(DACChip::Name name, byte addr) : DACChip(name)
 {
-  _name = name;
   _address = addr;
 }
 
-ES9028::ES9028(String name, Mode mode, byte addr)
+ES9028::ES9028(DACChip::Name name, Mode mode, byte addr) : DACChip(name)
 {
-  _name = name;
   _mode = mode;
   _address = addr;
 }
 
-String ES9028::getName()
+ES9028::ES9028(DACChip::Name name, Mode mode, byte addr, TwoWire &wire) : DACChip(name)
 {
-  return _name;
+  _mode = mode;
+  _address = addr;
+  _wire = &wire;
+}
+
+void ES9028::setMCLK(unsigned long val)
+{
+  _rateEstimate.setMCLK(val);
+}
+
+unsigned long ES9028::getMCLK()
+{
+  return _rateEstimate.getMCLK();
 }
 
 void ES9028::_printDAC()
@@ -37,7 +50,7 @@ void ES9028::_printDAC()
 void ES9028::_printDAC(Msg::Level level)
 {
   Msg::print(level, F("->"));
-  Msg::print(level, _name);
+  printName(level);
   Msg::print(level,F(" DAC ["));
   if (_chipType == Chip_ES9028PRO)
     Msg::print(level, F("ES9028 @"));
@@ -45,7 +58,7 @@ void ES9028::_printDAC(Msg::Level level)
     Msg::print(level, F("ES9038 @"));
   else
     Msg::print(level, F("->Unknown @"));
-  Msg::print(level, String(_address, HEX));
+  Msg::print(level, _address, HEX);
   Msg::print(level, F("]: "));
 }
 
@@ -61,7 +74,7 @@ bool ES9028::_readRegister(byte regAddr, byte &regVal)
   {
     _printDAC();
     Msg::print(Msg::E, F("Uninitialised Error reading status register "));
-    Msg::println(Msg::E, String(regAddr));
+    Msg::println(Msg::E, regAddr);
     return false;
   }
   if (noI2C)
@@ -74,20 +87,20 @@ bool ES9028::_readRegister(byte regAddr, byte &regVal)
   while (true)
   {
     retry = false;
-    Wire.beginTransmission(_address); 
-    Wire.write(regAddr);           
+    _wire->beginTransmission(_address); 
+    _wire->write(regAddr);           
     byte result;           
-    result = Wire.endTransmission();
+    result = _wire->endTransmission();
     if (result == 0) // success
     {
-      bool bytesReceived = Wire.requestFrom(_address, 1); // request one byte from address
+      bool bytesReceived = _wire->requestFrom(_address, 1); // request one byte from address
       if (bytesReceived == 0) // error
       {
         _printDAC(Msg::W);
         Msg::print(Msg::W, F("Zero bytes returned reading status register "));
-        Msg::print(Msg::W, String(regAddr));
+        Msg::print(Msg::W, regAddr);
         Msg::print(Msg::W, F(" after retry count of "));
-        Msg::println(Msg::W, String(_readRetries - readRetries + 1));
+        Msg::println(Msg::W, _readRetries - readRetries + 1);
         if (readRetries == 0)
         {
           return false;
@@ -97,12 +110,12 @@ bool ES9028::_readRegister(byte regAddr, byte &regVal)
       }
       if (!retry)
       {
-        regVal = Wire.read();         // Return the value returned by specified register
+        regVal = _wire->read();         // Return the value returned by specified register
         _printDAC(Msg::D);
         Msg::print(Msg::D, F("read value "));
-        Msg::print(Msg::D, String(regVal, BIN));
+        Msg::print(Msg::D, regVal, BIN);
         Msg::print(Msg::D, F(" from register "));
-        Msg::println(Msg::D, String(regAddr));
+        Msg::println(Msg::D, regAddr);
         return true;
       }
     }
@@ -110,7 +123,7 @@ bool ES9028::_readRegister(byte regAddr, byte &regVal)
     {
       _printDAC(Msg::E);
       Msg::print(Msg::E, F("Error reading status register "));
-      Msg::print(Msg::E, String(regAddr));
+      Msg::print(Msg::E, regAddr);
       switch (result)
       {
         case 1:
@@ -131,22 +144,142 @@ bool ES9028::_readRegister(byte regAddr, byte &regVal)
   }
 }
 
+bool ES9028::readRegisters(byte regAddr, byte regVals[], byte count) 
+{
+  if (!_initialised)
+  {
+    _printDAC(Msg::E);
+    Msg::print(Msg::E, F("Uninitialised Error reading registers from "));
+    Msg::println(Msg::E, regAddr);
+    return false;
+  }
+  if (noI2C)
+  {
+    memset(regVals, 0, count);
+    return true;
+  }
+  while (count > 0)
+  {
+    byte n = (count > _burstLength) ? _burstLength : count;
+    _wire->beginTransmission(_address); 
+    _wire->write(regAddr);           
+    if ((_wire->endTransmission() != 0) || (_wire->requestFrom(_address, n) != n))
+    {
+      _printDAC(Msg::E);
+      Msg::print(Msg::E, F("Error burst reading registers from "));
+      Msg::println(Msg::E, regAddr);
+      return false;
+    }
+    for (byte i = 0; i < n; i++)
+      regVals[i] = _wire->read();
+    regAddr += n;
+    regVals += n;
+    count -= n;
+  }
+  return true;
+}
+
+bool ES9028::writeRegisters(byte regAddr, const byte regVals[], byte count) 
+{
+  if (!_initialised)
+  {
+    _printDAC(Msg::E);
+    Msg::print(Msg::E, F("Uninitialised Error writing registers from "));
+    Msg::println(Msg::E, regAddr);
+    return false;
+  }
+  if (noI2C)
+    return true;
+  _printDAC(Msg::D);
+  Msg::print(Msg::D, F("Burst writing "));
+  Msg::print(Msg::D, count);
+  Msg::print(Msg::D, F(" registers from "));
+  Msg::println(Msg::D, regAddr);
+  while (count > 0)
+  {
+    byte n = (count > _burstLength) ? _burstLength : count;
+    _wire->beginTransmission(_address); 
+    _wire->write(regAddr);
+    _wire->write(regVals, n);
+    if (_wire->endTransmission() != 0)
+    {
+      _printDAC(Msg::E);
+      Msg::print(Msg::E, F("Error burst writing registers from "));
+      Msg::println(Msg::E, regAddr);
+      return false;
+    }
+    regAddr += n;
+    regVals += n;
+    count -= n;
+  }
+  return true;
+}
+
+bool ES9028::readImage(byte image[]) 
+{
+  return readRegisters(0, image, 32) && readRegisters(38, image + 32, 8) && readRegisters(62, image + 40, 1);
+}
+
+bool ES9028::writeImage(const byte image[]) 
+{
+  _printDAC();
+  Msg::println(F("writing register image"));
+  byte buf[ImageSize];
+  memcpy(buf, image, ImageSize);
+  buf[0] &= B11111110;          // never write the soft reset bit
+  byte readBack[ImageSize];
+  if (!readImage(readBack))
+    return false;
+  readBack[0] &= B11111110;
+  // only burst write the runs of registers that differ from the image
+  const byte spanReg[] = {0, 38, 62};
+  const byte spanStart[] = {0, 32, 40};
+  const byte spanEnd[] = {32, 40, ImageSize};
+  for (byte s = 0; s < 3; s++)
+  {
+    byte i = spanStart[s];
+    while (i < spanEnd[s])
+    {
+      if (buf[i] == readBack[i])
+      {
+        i++;
+        continue;
+      }
+      byte run = i;
+      while ((i < spanEnd[s]) && (buf[i] != readBack[i]))
+        i++;
+      if (!writeRegisters(spanReg[s] + run - spanStart[s], buf + run, i - run))
+        return false;
+    }
+  }
+  if (!readImage(readBack))
+    return false;
+  readBack[0] &= B11111110;
+  if (memcmp(buf, readBack, ImageSize) != 0)
+  {
+    _printDAC(Msg::E);
+    Msg::println(Msg::E, F("-Write Error- register image did not verify"));
+    return false;
+  }
+  return true;
+}
+
 bool ES9028::_writeRegister(byte regAddr, byte regVal)
 {
   if (!_initialised)
   {
     _printDAC(Msg::E);
     Msg::print(Msg::E, F("Uninitialised Error writing status register "));
-    Msg::println(Msg::E, String(regAddr));
+    Msg::println(Msg::E, regAddr);
     return false;
   }
   if (noI2C)
     return true;
   _printDAC(Msg::D);
   Msg::print(Msg::D, F(": Writing "));
-  Msg::print(Msg::D, String(regVal, BIN));
+  Msg::print(Msg::D, regVal, BIN);
   Msg::print(Msg::D, F(" to register "));
-  Msg::println(Msg::D, String(regAddr));
+  Msg::println(Msg::D, regAddr);
   byte readVal;
   bool readOk = _readRegister(regAddr, readVal);
   if (!readOk)
@@ -160,17 +293,17 @@ bool ES9028::_writeRegister(byte regAddr, byte regVal)
       Msg::println(Msg::D, F("-Write value same as register value- "));
     else
     {
-      Wire.beginTransmission(_address); 
-      Wire.write(regAddr);               // Specifying the address of register
-      int result = Wire.write(regVal);   // Writing the value into the register
-      Wire.endTransmission();
+      _wire->beginTransmission(_address); 
+      _wire->write(regAddr);               // Specifying the address of register
+      int result = _wire->write(regVal);   // Writing the value into the register
+      _wire->endTransmission();
       readOk = _readRegister(regAddr, readVal); // confirm write
       if (!readOk)
       {
         _printDAC(Msg::E);
         Msg::print(Msg::E, F("-Write Error- "));
         Msg::print(Msg::E, F(" could not read written value from register "));
-        Msg::println(Msg::E, String(regAddr));
+        Msg::println(Msg::E, regAddr);
         return false;
       }
       else
@@ -179,9 +312,9 @@ bool ES9028::_writeRegister(byte regAddr, byte regVal)
         {
           _printDAC(Msg::E);
           Msg::print(Msg::E, F("-Write Error- "));
-          Msg::print(Msg::E, String(readVal, BIN));
+          Msg::print(Msg::E, readVal, BIN);
           Msg::print(Msg::E, F(" read from register "));
-          Msg::println(Msg::E, String(regAddr));
+          Msg::println(Msg::E, regAddr);
           return false;
         }
         else
@@ -192,10 +325,11 @@ bool ES9028::_writeRegister(byte regAddr, byte regVal)
   return true;
 }
 
-boolean ES9028::_changeByte(byte &val, String bits)
+boolean ES9028::_changeByte(byte &val, const __FlashStringHelper *bits)
 {
   boolean result = false;
-  int l = bits.length();
+  const char *p = (const char *) bits;
+  int l = strlen_P(p);
   if (l != 8)
   {
     Msg::print(Msg::E, F("changebits: "));
@@ -204,7 +338,7 @@ boolean ES9028::_changeByte(byte &val, String bits)
   }
   for (int i=0; i<l; i++)
   {
-    char c = bits.charAt(i);
+    char c = pgm_read_byte(p + i);
     int x = bitRead(val, 7-i);
     switch (c) 
     {
@@ -235,7 +369,7 @@ boolean ES9028::_changeByte(byte &val, String bits)
   return result;
 }
 
-bool ES9028::_writeRegisterBits(byte regAddr, String bits) 
+bool ES9028::_writeRegisterBits(byte regAddr, const __FlashStringHelper *bits) 
 {
   byte regVal;
   bool ok = _readRegister(regAddr, regVal);
@@ -255,12 +389,30 @@ bool ES9028::reset()
 {
   if (getInitialised())
   {
-    _writeRegisterBits(0,"*******1");
+    _writeRegisterBits(0, F("*******1"));
     _setInitialised(false);
   }
   return true;
 }
 
+bool ES9028::probe(byte &chipId)
+{
+  // no logging or retries as the DAC is not expected to answer while its regulators ramp up
+  if (noI2C)
+  {
+    chipId = 0;
+    return true;
+  }
+  _wire->beginTransmission(_address); 
+  _wire->write(64);
+  if (_wire->endTransmission() != 0)
+    return false;
+  if (_wire->requestFrom(_address, 1) == 0)
+    return false;
+  chipId = _wire->read() & B11111100;   // bits 1:0 hold the automute and lock flags
+  return true;
+}
+
 boolean ES9028::initialise()
 {
   _printDAC();
@@ -305,6 +457,16 @@ byte ES9028::getAddress()
   return _address;
 }
 
+TwoWire* ES9028::getWire()
+{
+  return _wire;
+}
+
+void ES9028::setWire(TwoWire &wire)
+{
+  _wire = &wire;
+}
+
 bool ES9028::setOscillatorDrive(OscillatorDrive val)
 {
   _printDAC();
@@ -474,6 +636,43 @@ bool ES9028::setInputSelect(InputSelect val)
   }
 }
 
+bool ES9028::selectInput(InputSelect val)
+{
+  // Reg 1: auto_select disabled (bits 3:2 = 00) and input_select written together, so the chip cannot pick another source
+  _printDAC();
+  Msg::print(F("selecting input "));
+  switch(val)
+  {
+  case InputSelect_DSD:
+    Msg::println(F("DSD"));
+    return _writeRegisterBits(1, F("****0011"));
+    break;
+  case InputSelect_SPDIF:
+    Msg::println(F("SPDIF"));
+    return _writeRegisterBits(1, F("****0001"));
+    break;
+  case InputSelect_SERIAL:
+    Msg::println(F("SERIAL"));
+    return _writeRegisterBits(1, F("****0000"));
+    break;
+  default:
+    return _invalidSetting();
+  }
+}
+
+bool ES9028::selectSource(DACChip::Source val)
+{
+  switch(val)
+  {
+  case Source_SPDIF:
+    return selectInput(InputSelect_SPDIF);
+  case Source_DSD:
+    return selectInput(InputSelect_DSD);
+  default:
+    return selectInput(InputSelect_SERIAL);
+  }
+}
+
 bool ES9028::setAutoMute(AutoMute val)
 {
   _printDAC();
@@ -657,10 +856,15 @@ bool ES9028::setVolumeRate(byte val)  // Selects a volume ramp rate to use when
     return _invalidSetting();
   byte b;
   if (_readRegister(6, b))
-    return _writeRegister(6, b | val);
+    return _writeRegister(6, (b & B11111000) | val);
   return false;
 }
 
+bool ES9028::setFilterShape(byte val)
+{
+  return setFilterShape((FilterShape) val);
+}
+
 bool ES9028::setFilterShape(FilterShape val)  // Selects the type of filter to use during the 8x FIR interpolation phase.
 {
   _printDAC();
@@ -1595,6 +1799,91 @@ bool ES9028::disableVolumeLatching()
   return _writeRegisterBits(15, F("*******0"));
 }
 
+bool ES9028::stageVolume1(byte val) 
+{
+  if (!disableVolumeLatching())
+    return false;
+  if (!_readRegister(15, _reg15))
+    return false;
+  return setVolume1(val);
+}
+
+bool ES9028::stageVolumes(const byte vals[]) 
+{
+  if (!disableVolumeLatching())
+    return false;
+  if (!_readRegister(15, _reg15))
+    return false;
+  return setVolumes(vals);
+}
+
+bool ES9028::setVolumes(const byte vals[]) 
+{
+  _printDAC();
+  Msg::println(F("set Volumes"));
+  byte current[ChannelCount];
+  if (!readRegisters(16, current, ChannelCount))
+    return false;
+  // a single burst from the first to the last channel that changed
+  byte first = 0;
+  while ((first < ChannelCount) && (vals[first] == current[first]))
+    first++;
+  if (first == ChannelCount)
+    return true;
+  byte last = ChannelCount - 1;
+  while (vals[last] == current[last])
+    last--;
+  return writeRegisters(16 + first, vals + first, last - first + 1);
+}
+
+bool ES9028::setMasterAttenuation(byte val) 
+{
+  return setVolume1(val);
+}
+
+bool ES9028::setChannelAttenuations(const byte vals[]) 
+{
+  return setVolumeMode(Volume_Independent) && setVolumes(vals);
+}
+
+bool ES9028::stageMasterAttenuation(byte val) 
+{
+  return stageVolume1(val);
+}
+
+bool ES9028::stageChannelAttenuations(const byte vals[]) 
+{
+  return setVolumeMode(Volume_Independent) && stageVolumes(vals);
+}
+
+bool ES9028::isLeftChannel(byte channel) 
+{
+  switch (_mode)
+  {
+  case MonoLeft:
+  case DualLeft:
+    return true;
+  case MonoRight:
+  case DualRight:
+    return false;
+  default:
+    return (channel & 1) == 0;
+  }
+}
+
+bool ES9028::releaseVolume() 
+{
+  // timing critical, so no logging or read back. enableVolumeLatching() can be used afterwards to verify
+  if (!_initialised)
+    return false;
+  if (noI2C)
+    return true;
+  _wire->beginTransmission(_address); 
+  _wire->write(15);
+  _wire->write(_reg15 | B00000001);
+  return (_wire->endTransmission() == 0);
+}
+
 bool ES9028::setVolume1(byte val) 
 {
   _printDAC();
@@ -1657,14 +1946,18 @@ bool ES9028::setMasterTrim(unsigned long val)
   Msg::println(F("set Master Trim"));
   byte buf[4];   
   buf[0] = (byte) val;
-  buf[1] = (byte) val >> 8;
-  buf[2] = (byte) val >> 16;
-  buf[3] = (byte) val >> 24;  
-  if (_writeRegister(24, buf[0]))
-    if (_writeRegister(25, buf[1]))
-      if (_writeRegister(26, buf[2]))
-        return (_writeRegister(27, buf[3]));
-  return false;
+  buf[1] = (byte) (val >> 8);
+  buf[2] = (byte) (val >> 16);
+  buf[3] = (byte) (val >> 24);  
+  // one burst so the DAC never runs with a partly updated trim
+  return writeRegisters(24, buf, 4);
+}
+
+bool ES9028::setFineAttenuation(byte val)
+{
+  if (val >= FineSteps)
+    return _invalidSetting();
+  return setMasterTrim(pgm_read_dword(&_fineTrim[val]));
 }
 
 bool ES9028::setTHDCompensationC2(int val)
@@ -1673,7 +1966,7 @@ bool ES9028::setTHDCompensationC2(int val)
   Msg::println(F("set THD Compensation C2"));
   byte buf[2];   
   buf[0] = (byte) val;
-  buf[1] = (byte) val >> 8;
+  buf[1] = (byte) (val >> 8);
   if (_writeRegister(28, buf[0]))
     return (_writeRegister(29, buf[1]));
   return false;
@@ -1685,7 +1978,7 @@ bool ES9028::setTHDCompensationC3(int val)
   Msg::println(F("set THD Compensation C3"));
   byte buf[2];   
   buf[0] = (byte) val;
-  buf[1] = (byte) val >> 8;
+  buf[1] = (byte) (val >> 8);
   if (_writeRegister(30, buf[0]))
     return (_writeRegister(31, buf[1]));
   return false;
@@ -1736,9 +2029,9 @@ bool ES9028::setFIRCoeff(unsigned long val)
   Msg::println(F("set FIR Coefficient"));
   byte buf[4];   
   buf[0] = (byte) val;
-  buf[1] = (byte) val >> 8;
-  buf[2] = (byte) val >> 16;
-  buf[3] = (byte) val >> 24;  
+  buf[1] = (byte) (val >> 8);
+  buf[2] = (byte) (val >> 16);
+  buf[3] = (byte) (val >> 24);  
   if (_writeRegister(33, buf[0]))
     if (_writeRegister(34, buf[1]))
       if (_writeRegister(35, buf[2]))
@@ -1858,9 +2151,9 @@ bool ES9028::setProgrammableNCO(unsigned long val) // An unsigned 32-bit quantit
   Msg::println(F("set programmable NCO"));
   byte buf[4];   
   buf[0] = (byte) val;
-  buf[1] = (byte) val >> 8;
-  buf[2] = (byte) val >> 16;
-  buf[3] = (byte) val >> 24;  
+  buf[1] = (byte) (val >> 8);
+  buf[2] = (byte) (val >> 16);
+  buf[3] = (byte) (val >> 24);  
   if (_writeRegister(42, buf[0]))
     if (_writeRegister(43, buf[1]))
       if (_writeRegister(44, buf[2]))
@@ -1905,7 +2198,7 @@ bool ES9028::_getChipType(ChipType &chipType)
   {
     r = r >> 2;
     Msg::print(F("-> Chip ID is "));
-    Msg::println(String(r, BIN));
+    Msg::println(r, BIN);
     //if ((r == B101001) || (r == B101000)) dimdims code
     if (r == B101000)
       chipType = Chip_ES9028PRO;
@@ -1955,6 +2248,20 @@ bool ES9028::locked(bool &readError)
   }
 }
 
+bool ES9028::readStatus(bool &lockStatus, bool &automuteStatus)
+{
+  byte status;
+  if (_readRegister(64, status))
+  {
+    lockStatus = status & B00000001;
+    automuteStatus = status & B00000010;
+    return true;
+  }
+  lockStatus = false;
+  automuteStatus = false;
+  return false;
+}
+
 bool ES9028::_locked(bool &lockStatus)
 {
   byte status;
@@ -2054,28 +2361,94 @@ ES9028::SignalType ES9028::getSignalType()  // returns signal type.
 unsigned long ES9028::dpllNumber()  // returns the ratio between the MCLK and the audio clock rate once the DPLL has acquired lock
 {
   _printDAC();
-  Msg::println(F("read DPLL Number: "));
-  byte b1 = 0;
-  byte b2 = 0;
-  byte b3 = 0;
-  byte b4 = 0;
-  long dpllnum = 0;
-  _readRegister(66, b1);
-  _readRegister(67, b2);
-  _readRegister(68, b3);
-  _readRegister(69, b4);
-  dpllnum += (b1 << 24);
-  Msg::println(String(dpllnum));
-  return dpllnum;
+  Msg::print(F("read DPLL Number: "));
+  unsigned long dpllNum;
+  _readDpllNumber(dpllNum);
+  Msg::println(dpllNum);
+  return dpllNum;
+}
+
+bool ES9028::_readDpllNumber(unsigned long &val)
+{
+  // registers 66-69 hold the DPLL number least significant byte first
+  byte b[4];
+  if (!readRegisters(66, b, 4))
+  {
+    val = 0;
+    return false;
+  }
+  val = ((unsigned long)b[3] << 24) | ((unsigned long)b[2] << 16) | ((unsigned long)b[1] << 8) | b[0];
+  return true;
 }
 
 unsigned long ES9028::getSampleRate()  // returns the sample rate
 {
   _printDAC();
-  Msg::println(F("read sample rate: "));
-  long sampleRate = (dpllNumber()*clock)/42940;
-  Msg::println(String(sampleRate));
-  return sampleRate;
+  Msg::print(F("read sample rate: "));
+  unsigned long dpllNum;
+  _readDpllNumber(dpllNum);
+  // FSR = DPLL number * MCLK / 2^32
+  _rateEstimate.measure(dpllNum);
+  Msg::println(_rateEstimate.getRate());
+  return _rateEstimate.getRate();
+}
+
+const SampleRate& ES9028::getRateEstimate()
+{
+  return _rateEstimate;
+}
+
+bool ES9028::readSignal(SignalType &type, unsigned long &sampleRate)
+{
+  // quiet so it can be polled, one read of register 100 and a burst read of the DPLL number
+  type = Signal_NONE;
+  sampleRate = 0;
+  byte b;
+  if (!_readRegister(100, b))
+    return false;
+  // DoP is carried on the I2S or SPDIF input, so it is checked before them
+  if (b & B00000001)
+    type = Signal_DSD;
+  else if (b & B00001000)
+    type = Signal_DoP;
+  else if (b & B00000010)
+    type = Signal_I2S;
+  else if (b & B00000100)
+    type = Signal_SPDIF;
+  unsigned long dpllNum;
+  if (!_readDpllNumber(dpllNum))
+    return false;
+  if (_rateEstimate.measure(dpllNum, type == Signal_DSD))
+    sampleRate = _rateEstimate.getNominal();
+  else
+    sampleRate = _rateEstimate.getRate();
+  return true;
+}
+
+ES9028::FilterProfile ES9028::filterProfile(FilterShape filterShape, IIR_Bandwidth iirBandwidth, DpllBandwidth dpllSerial, DpllBandwidth dpllDSD)
+{
+  // same encodings as setFilterShape(), setIIR_Bandwidth(), setDpllBandwidthSerial() and setDpllBandwidthDSD()
+  FilterProfile profile;
+  profile.reg7 = ((6 - filterShape) << 5) | ((3 - iirBandwidth) << 1);
+  profile.reg12 = (dpllSerial << 4) | dpllDSD;
+  return profile;
+}
+
+bool ES9028::applyFilterProfile(const FilterProfile &val)
+{
+  _printDAC();
+  Msg::println(F("applying filter profile"));
+  // one burst read of registers 7-12, then only the registers that differ are written
+  byte regs[6];
+  if (!readRegisters(7, regs, 6))
+    return false;
+  // keep the other register 7 bits, including mute
+  byte reg7 = (regs[0] & ~B11100110) | (val.reg7 & B11100110);
+  if ((reg7 != regs[0]) && !_writeRegister(7, reg7))
+    return false;
+  if ((val.reg12 != regs[5]) && !_writeRegister(12, val.reg12))
+    return false;
+  return true;
 }
 
 
@@ -4,11 +4,17 @@
   Use entirely at your own risk!
 
   (see the WIRE library for details on connecting an I2C device to an Arduino board. Be aware that most I2C devices use 3.3 volts!)
+
+  The library does not allocate from the heap. On AVR each instance uses 44 bytes of RAM: 6 for the DACChip base (vtable
+  pointer, name pointer and flags) and 38 for the settings, 22 of them the sample rate estimate. Pass the name as a PROGMEM
+  string to keep its characters in flash.
 */
 
 #include <global.h>
 #include "SerialHelper.h"
 #include <Wire.h>
+#include <SampleRate.h>
+#include <DACChip.h>
 
 #ifndef ES9028_h
 #define ES9028_h
@@ -21,7 +27,7 @@
 #endif
 
 
-class ES9028
+class ES9028 : public DACChip
 {
   public:
     enum Mode{MonoLeft=0, MonoRight=1, Stereo=2, EightChannel=3, DualLeft=4, DualRight=5};
@@ -52,19 +58,25 @@ class ES9028
     enum Gain{Gain_None=0, Gain_18db=1};
     enum ChipType{Chip_Unknown=0, Chip_ES9028PRO=1, Chip_ES9038PRO=2};
     enum SignalType{Signal_DoP=0, Signal_SPDIF=1, Signal_I2S=2, Signal_DSD=3, Signal_NONE=4};
+    static const byte ImageSize = 41;               // size of a register image: registers 0-31, 38-45 and 62
+    static const byte ChannelCount = 8;             // DAC channels, with volume registers 16-23
+    static const byte FineSteps = 20;               // 0.05dB master trim steps of setFineAttenuation()
     
-    ES9028(String name);                            // default to 8 channel mode with default I2C address 0x48
-    ES9028(String name, Mode mode);
-    ES9028(String name, byte addr);                 // default to 8 channel mode with default I2C address 0x48
-    ES9028(String name, Mode mode, byte addr);    
-    byte clock = 10;				                        // value of clock used (in 10s of MHz). 10 = 100MHz.
-    bool noI2C = false;                             // set to true for debugging/development of code when Arduino not connected via I2C to DAC
+    ES9028(DACChip::Name name);                            // default to 8 channel mode with default I2C address 0x48
+    ES9028(DACChip::Name name, Mode mode);
+    ES9028(DACChip::Name name, byte addr);                 // default to 8 channel mode with default I2C address 0x48
+    ES9028(DACChip::Name name, Mode mode, byte addr);    
+    ES9028(DACChip::Name name, Mode mode, byte addr, TwoWire &wire); // DAC on an I2C bus other than Wire (e.g. Wire1 on the ESP32)
+    void setMCLK(unsigned long val);                // MCLK frequency in Hz used to calculate the sample rate (default 100MHz)
+    unsigned long getMCLK();
     bool initialise();                              // writes mode and phase values. Other registers can only be changed after this method is called.
+    bool probe(byte &chipId);                       // quietly reads the chip ID before initialisation. Returns false if the DAC does not answer
     bool getInitialised();  
     ES9028::Mode getMode();
     bool reset();
-    String getName();
     byte getAddress();                              // returns the I2C address
+    TwoWire* getWire();                             // returns the I2C bus the DAC is connected to
+    void setWire(TwoWire &wire);                    // sets the I2C bus the DAC is connected to (defaults to Wire)
     bool setOscillatorDrive(OscillatorDrive val);   // Configures a clock divider network that can reduce the power consumption of the chip
     bool setClockGear(ClockGear val);               // Software configurable hardware reset with the ability to reset the design to its initial power-on configuration.
     bool setSPDIFUserBits(SPDIFUserBits val);       // Setting user_bits will present the SPDIF user bits on the read-only register interface instead of the default channel status bits.
@@ -72,6 +84,8 @@ class ES9028
     bool setSPDIFValidFlag(SPDIFValidFlag val);     // Configures the SPDIF decoder to ignore the �valid� flag in the SPDIF stream.
     bool setAutoSelect(AutoSelect val);             // Allows the SABRE DAC to automatically select between either serial, SPDIF or DSD input formats
     bool setInputSelect(InputSelect val);           // Configures the SABRE DAC to use a particular input decoder if auto_select is disabled.
+    bool selectInput(InputSelect val);              // disables auto_select and selects the input decoder in a single register write
+    bool selectSource(DACChip::Source val);         // selectInput() for the DACChip interface
     bool setAutoMute(AutoMute val);                 // Configures the automute state machine
     bool setSerialBits(Bits val);                   // Selects how many bits consist of a data word in the serial data stream.
     bool setSerialLength(Bits val);                 // Selects how many DATA_CLK pulses exist per data word.
@@ -85,6 +99,7 @@ class ES9028
     bool setDeEmphSelect(DeEmphSelect val);         // Selects which de-emphasis filter is used.
     bool setVolumeRate(byte val);                   // Selects a volume ramp rate to use when transitioning between different volume levels. The volume ramp rate is measured in decibels per second (dB/s). Volume rate is in the range 0-7.
     bool setFilterShape(FilterShape val);           // Selects the type of filter to use during the 8x FIR interpolation phase.
+    bool setFilterShape(byte val);                  // as above for the DACChip interface
     bool setIIR_Bandwidth(IIR_Bandwidth val);       // Selects the type of filter to use during the 8x IIR interpolation phase.
     bool mute();                                    // Mutes all 8 channels of the SABRE DAC.
     bool unmute();                                  // Unmutes all 8 channels of the SABRE DAC.
@@ -124,6 +139,15 @@ class ES9028
     bool setVolumeMode(VolumeMode val);             // Force all eight channels to use the volume coefficients from channel 1.
     bool enableVolumeLatching();                    // enables the volume control registers (default)
     bool disableVolumeLatching();                   // disables latching of the volume control registers
+    bool stageVolume1(byte val);                    // disables volume latching and writes the channel 1 volume without applying it. Call releaseVolume() to apply
+    bool releaseVolume();                           // re-enables volume latching with a single unverified write so that volumes staged on several DACs apply with minimal skew
+    bool setVolumes(const byte vals[]);             // sets the ChannelCount channel volumes with one burst read and one burst write spanning the channels that changed. Needs Volume_Independent
+    bool stageVolumes(const byte vals[]);           // as stageVolume1() for all channels. Call releaseVolume() to apply
+    bool setMasterAttenuation(byte val);            // DACChip interface: setVolume1()
+    bool setChannelAttenuations(const byte vals[]); // DACChip interface: selects Volume_Independent and setVolumes()
+    bool stageMasterAttenuation(byte val);          // DACChip interface: stageVolume1()
+    bool stageChannelAttenuations(const byte vals[]); // DACChip interface: selects Volume_Independent and stageVolumes()
+    bool isLeftChannel(byte channel);               // follows the mode, odd channels (numbered from 1) are left in stereo and eight channel mode
     bool setVolume1(byte val);                      // Channel 1 - Default of 8�d0 -0dB to -127.5dB with 0.5dB steps
     bool setVolume2(byte val);                      // Channel 2 - Default of 8�d0 -0dB to -127.5dB with 0.5dB steps
     bool setVolume3(byte val);                      // Channel 3 - Default of 8�d0 -0dB to -127.5dB with 0.5dB steps
@@ -133,6 +157,7 @@ class ES9028
     bool setVolume7(byte val);                      // Channel 7 - Default of 8�d0 -0dB to -127.5dB with 0.5dB steps
     bool setVolume8(byte val);                      // Channel 8 - Default of 8�d0 -0dB to -127.5dB with 0.5dB steps
     bool setMasterTrim(unsigned long val);          // A 32-bit signed value that sets the 0dB level for all volume controls. Defaults to full-scale (32�h7FFFFFFF).
+    bool setFineAttenuation(byte val);              // attenuation below the 0.5dB volume steps, in 0.05dB steps (0 to FineSteps-1), written to the master trim in one burst
     bool setTHDCompensationC2(int val);             // A 16-bit signed coefficient for correcting for the second harmonic distortion. Defaults to 16�d0.
     bool setTHDCompensationC3(int val);             // A 16-bit signed coefficient for correcting for the third harmonic distortion. Defaults to 16�d0.
     bool setFIRCoeffStage(FIRCoeffStage val);       // Selects which stage of the filter to write.
@@ -158,32 +183,45 @@ class ES9028
     bool getAutomuted(bool &automuteStatus);        // returns true if Automute read successful and sets the parameter reference to true if Automute has been flagged and is active
     bool locked();                                  // returns true if DPLL is locked to the incoming audio sample rate, or the Sabre is in master mode, 128fs_mode or NCO mode mode
     bool locked(bool &readError);
+    bool readStatus(bool &lockStatus, bool &automuteStatus); // reads the lock and automute flags with a single register read. Returns false on read error
     bool dopValid();                                // returns true if the DoP decoder has detected a valid DoP signal on the I2S or SPDIF inputs.
     bool spdifValid();                              // returns true if the SPDIF decoder has decoded a sequence of valid SPDIF frames.
     bool i2sValid();                                // returns true if the I2S decoder has detected a valid frame clock and bit clock arrangement.
     bool dsdValid();                                // returns true if the DSD decoder is being used as a fallback option if I2S and SPDIF have both failed to decode their respective input signals.
     ES9028::SignalType getSignalType();             // returns signal type.
     unsigned long dpllNumber();                     // returns the ratio between the MCLK and the audio clock rate once the DPLL has acquired lock
-    unsigned long getSampleRate();                  // returns the sample rate
+    unsigned long getSampleRate();                  // returns the measured sample rate in Hz
+    bool readSignal(SignalType &type, unsigned long &sampleRate); // quietly reads the signal type and sample rate (Hz, snapped to the standard rate if within tolerance) for polling. Returns false on read error
+    const SampleRate& getRateEstimate();            // details of the last sample rate measurement (nominal rate, family, ppm error)
+    static ES9028::FilterProfile filterProfile(FilterShape filterShape, IIR_Bandwidth iirBandwidth, DpllBandwidth dpllSerial, DpllBandwidth dpllDSD);
+    bool applyFilterProfile(const FilterProfile &val); // writes only the filter, IIR and DPLL settings that differ from the profile
     bool setAttenuation(byte attenuation);          // sets the same attenuation for each DAC
+    bool readRegisters(byte regAddr, byte regVals[], byte count);        // reads consecutive registers using auto-increment burst reads
+    bool writeRegisters(byte regAddr, const byte regVals[], byte count); // writes consecutive registers using auto-increment burst writes (not verified)
+    bool readImage(byte image[]);                   // reads the configuration registers into an image of ImageSize bytes
+    bool writeImage(const byte image[]);            // burst writes the registers that differ from an image read by readImage() and verifies it with a bulk read
   private:
     Mode _mode = EightChannel;                      // default is eight channel mode
-    String _name;
     byte _address = 0x48;                           // set default I2C address
+    TwoWire *_wire = &Wire;                         // I2C bus the DAC is connected to
     bool _initialised = false;
     bool _locked(bool &lockStatus);
     ChipType _chipType = Chip_Unknown;
     const int _readRetries = 5;                     // _readRegister read error retries
+    const byte _burstLength = 30;                   // registers per burst transaction (the AVR Wire buffer is 32 bytes)
     Phase _oddChannels = InPhase;
     Phase _evenChannels = InPhase;
+    SampleRate _rateEstimate;                       // MCLK and last sample rate measurement
+    byte _reg15 = 0;                                // register 15 as read by stageVolume1(), used by releaseVolume()
 
     bool _readRegister(byte regAddr, byte &regVal); 
+    bool _readDpllNumber(unsigned long &val);
     bool _writeRegister(byte regAddr, byte regVal); // writes the specified register value to the specified DAC register via I2C
-    bool _writeRegisterBits(byte regAddr, String bits); 
+    bool _writeRegisterBits(byte regAddr, const __FlashStringHelper *bits); 
     bool _writeMode();
     bool _writePhase();
     bool _invalidSetting();
-    bool _changeByte(byte &val, String bits);
+    bool _changeByte(byte &val, const __FlashStringHelper *bits);
     void _setInitialised(boolean val);
     void _printDAC();
     void _printDAC(Msg::Level level);
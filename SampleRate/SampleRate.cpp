@@ -0,0 +1,123 @@
+#include "SampleRate.h"
+
+SampleRate::SampleRate()
+{
+}
+
+SampleRate::SampleRate(unsigned long mclk)
+{
+  _mclk = mclk;
+}
+
+void SampleRate::setMCLK(unsigned long val)
+{
+  _mclk = val;
+}
+
+unsigned long SampleRate::getMCLK() const
+{
+  return _mclk;
+}
+
+void SampleRate::setTolerance(unsigned int ppm)
+{
+  _tolerance = ppm;
+}
+
+bool SampleRate::measure(unsigned long dpllNumber, bool dsd, byte dpllShift)
+{
+  // the product is the rate in Hz as a fixed point number with 32 + dpllShift fractional bits
+  unsigned long long measured = (unsigned long long)dpllNumber * _mclk;
+  byte fraction = 32 + dpllShift;
+  _rate = (measured + (1ULL << (fraction - 1))) >> fraction;
+  _nominal = 0;
+  _family = Family_Unknown;
+  _multiple = 0;
+  _errorPPM = 0;
+  if (_rate == 0)
+    return false;
+
+  // nearest power of two multiple within each family, compared on whole Hz so that only the winner needs a division
+  unsigned long nominal;
+  byte shift;
+  Family family;
+  if (dsd)
+  {
+    nominal = _nearest(_rate, 2822400UL, 3, shift);  // DSD64 to DSD512
+    family = Family_DSD;
+    shift += 6;
+  }
+  else
+  {
+    byte shift48k;
+    nominal = _nearest(_rate, 44100UL, 4, shift);    // 44.1k to 705.6k
+    unsigned long nominal48k = _nearest(_rate, 48000UL, 4, shift48k);  // 48k to 768k
+    unsigned long diff = (_rate > nominal) ? _rate - nominal : nominal - _rate;
+    unsigned long diff48k = (_rate > nominal48k) ? _rate - nominal48k : nominal48k - _rate;
+    family = Family_44k1;
+    // compare the relative errors diff / nominal without dividing
+    if ((unsigned long long)diff48k * nominal < (unsigned long long)diff * nominal48k)
+    {
+      nominal = nominal48k;
+      shift = shift48k;
+      family = Family_48k;
+    }
+  }
+
+  // error in ppm from the full precision measurement
+  long long nominalFixed = (long long)nominal << fraction;
+  long long error = (long long)measured - nominalFixed;
+  long errorPPM = error / (nominalFixed / 1000000);
+  if ((errorPPM > (long)_tolerance) || (errorPPM < -(long)_tolerance))
+    return false;
+  _nominal = nominal;
+  _family = family;
+  _multiple = 1 << shift;
+  _errorPPM = errorPPM;
+  return true;
+}
+
+unsigned long SampleRate::getRate() const
+{
+  return _rate;
+}
+
+unsigned long SampleRate::getNominal() const
+{
+  return _nominal;
+}
+
+SampleRate::Family SampleRate::getFamily() const
+{
+  return _family;
+}
+
+unsigned int SampleRate::getMultiple() const
+{
+  return _multiple;
+}
+
+long SampleRate::getErrorPPM() const
+{
+  return _errorPPM;
+}
+
+byte SampleRate::getConfidence() const
+{
+  if ((_nominal == 0) || (_tolerance == 0))
+    return 0;
+  unsigned long error = (_errorPPM < 0) ? -_errorPPM : _errorPPM;
+  return 100 - (error * 100) / _tolerance;
+}
+
+unsigned long SampleRate::_nearest(unsigned long rate, unsigned long base, byte maxShift, byte &shift)
+{
+  // step up while the next multiple is nearer, i.e. while rate is more than 1.5x the current multiple
+  shift = 0;
+  while ((shift < maxShift) && (rate > base + (base >> 1)))
+  {
+    base <<= 1;
+    shift++;
+  }
+  return base;
+}
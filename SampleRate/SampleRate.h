@@ -0,0 +1,45 @@
+/*
+  Sample rate estimation from a Sabre DAC's DPLL number, snapped to the standard rate families
+*/
+
+#ifndef SampleRate_h
+#define SampleRate_h
+#if ARDUINO >= 100
+  #include "Arduino.h"
+#else
+  #include "WProgram.h"
+  #include "pins_arduino.h"
+  #include "WConstants.h"
+#endif
+
+class SampleRate
+{
+  public:
+    enum Family{Family_Unknown=0, Family_44k1=1, Family_48k=2, Family_DSD=3};
+
+    SampleRate();
+    SampleRate(unsigned long mclk);                 // MCLK frequency in Hz
+    void setMCLK(unsigned long val);                // MCLK frequency in Hz (default 100MHz)
+    unsigned long getMCLK() const;
+    void setTolerance(unsigned int ppm);            // largest error that still snaps to a standard rate (default 2000ppm)
+    bool measure(unsigned long dpllNumber, bool dsd = false, byte dpllShift = 0); // FSR = dpllNumber * MCLK / 2^(32 + dpllShift). Returns true if the rate snapped to a standard rate
+    unsigned long getRate() const;                  // measured rate in Hz
+    unsigned long getNominal() const;               // standard rate the last measurement snapped to, 0 if none was within tolerance
+    SampleRate::Family getFamily() const;
+    unsigned int getMultiple() const;               // nominal rate / family base rate, e.g. 4 for 176.4k or 64 for DSD64
+    long getErrorPPM() const;                       // error of the measured rate relative to the nominal rate
+    byte getConfidence() const;                     // 100 at the nominal rate falling to 0 at the tolerance, 0 if not snapped
+
+  private:
+    unsigned long _mclk = 100000000UL;
+    unsigned int _tolerance = 2000;
+    unsigned long _rate = 0;
+    unsigned long _nominal = 0;
+    Family _family = Family_Unknown;
+    unsigned int _multiple = 0;
+    long _errorPPM = 0;
+
+    static unsigned long _nearest(unsigned long rate, unsigned long base, byte maxShift, byte &shift);
+};
+
+#endif
@@ -155,35 +155,35 @@ void Msg::print(Msg::Level level, long val, int base)
     switch (level)
     {
         case D:
-        rprintD(val);
+        rprintD(val, base);
         break;
         case I:
-        rprintI(val);
+        rprintI(val, base);
         break;
         case W:
-        rprintW(val);
+        rprintW(val, base);
         break;
         case E:
-        rprintE(val);
+        rprintE(val, base);
         break;
     };
     #ifdef UseSerial
-        Serial.print(val);
+        Serial.print(val, base);
     #endif
     #else
     switch (level)
     {
         case D:
-        printD(val);
+        printD(val, base);
         break;
         case I:
-        printI(val);
+        printI(val, base);
         break;
         case W:
-        printW(val);
+        printW(val, base);
         break;
         case E:
-        printE(val);
+        printE(val, base);
         break;
     };
     #endif;
@@ -195,35 +195,35 @@ void Msg::print(Msg::Level level, unsigned long val, int base)
     switch (level)
     {
         case D:
-        rprintD(val);
+        rprintD(val, base);
         break;
         case I:
-        rprintI(val);
+        rprintI(val, base);
         break;
         case W:
-        rprintW(val);
+        rprintW(val, base);
         break;
         case E:
-        rprintE(val);
+        rprintE(val, base);
         break;
     };
     #ifdef UseSerial
-        Serial.print(val);
+        Serial.print(val, base);
     #endif
     #else
     switch (level)
     {
         case D:
-        printD(val);
+        printD(val, base);
         break;
         case I:
-        printI(val);
+        printI(val, base);
         break;
         case W:
-        printW(val);
+        printW(val, base);
         break;
         case E:
-        printE(val);
+        printE(val, base);
         break;
     };
     #endif;
@@ -480,22 +480,22 @@ void Msg::println(Msg::Level level, long val, int base)
         break;
     };
     #ifdef UseSerial
-        Serial.println(val);
+        Serial.println(val, base);
     #endif
     #else
     switch (level)
     {
         case D:
-        printlnD(val);
+        printlnD(val, base);
         break;
         case I:
-        printlnI(val);
+        printlnI(val, base);
         break;
         case W:
-        printlnW(val);
+        printlnW(val, base);
         break;
         case E:
-        printlnE(val);
+        printlnE(val, base);
         break;
     };
     #endif;
@@ -520,22 +520,22 @@ void Msg::println(Msg::Level level, unsigned long val, int base)
         break;
     };
     #ifdef UseSerial
-        Serial.println(val);
+        Serial.println(val, base);
     #endif
     #else
     switch (level)
     {
         case D:
-        printlnD(val);
+        printlnD(val, base);
         break;
         case I:
-        printlnI(val);
+        printlnI(val, base);
         break;
         case W:
-        printlnW(val);
+        printlnW(val, base);
         break;
         case E:
-        printlnE(val);
+        printlnE(val, base);
         break;
     };
     #endif;
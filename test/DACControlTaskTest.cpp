@@ -0,0 +1,178 @@
+/*
+  DACControlTask across threads: DACQueue and DACLatest with a std::thread producer and consumer, then the task itself
+  driving 2 ES9028s on the simulated I2C bus. Needs DACCONTROLTASK_STD_THREAD, which test/run.sh defines.
+*/
+
+#include "host/HostTest.h"
+#include <Wire.h>
+#include <DACControlTask.h>
+
+#ifdef DACCONTROLTASK_STD_THREAD
+
+static void testQueue()
+{
+  // every item arrives once and in order, with the producer retrying while the queue is full
+  const unsigned long count = 200000;
+  DACQueue<unsigned long, 8> queue;
+  unsigned long outOfOrder = 0;
+  unsigned long received = 0;
+  std::thread consumer([&]()
+  {
+    unsigned long item;
+    while (received < count)
+    {
+      if (!queue.pop(item))
+      {
+        std::this_thread::yield();                  // the tests may run on a single core
+        continue;
+      }
+      if (item != received)
+        outOfOrder++;
+      received++;
+    }
+  });
+  for (unsigned long i = 0; i < count; i++)
+  {
+    while (!queue.push(i))
+      std::this_thread::yield();
+  }
+  consumer.join();
+  CHECK(received == count);
+  CHECK(outOfOrder == 0);
+}
+
+static void testLatest()
+{
+  // each round sets 1 to 200 and waits until the consumer has seen 200, so fewer than 256 changes are ever missed
+  const byte roundSize = 200;
+  const unsigned int rounds = 500;
+  DACLatest latest;
+  std::atomic<unsigned int> roundsSeen(0);
+  unsigned long taken = 0;
+  unsigned long coalesced = 0;
+  unsigned long wentBack = 0;
+  std::thread consumer([&]()
+  {
+    byte previous = 0;
+    byte val;
+    while (roundsSeen < rounds)
+    {
+      if (!latest.take(val, coalesced))
+      {
+        std::this_thread::yield();
+        continue;
+      }
+      taken++;
+      if (val <= previous)
+        wentBack++;                                 // an older value was taken after a newer one
+      previous = val;
+      if (val == roundSize)
+      {
+        previous = 0;
+        roundsSeen++;
+      }
+    }
+  });
+  for (unsigned int r = 0; r < rounds; r++)
+  {
+    for (byte i = 1; i <= roundSize; i++)
+      latest.set(i);
+    while (roundsSeen == r)
+      std::this_thread::yield();
+  }
+  consumer.join();
+  CHECK(taken + coalesced == (unsigned long) rounds * roundSize);
+  CHECK(wentBack == 0);
+}
+
+ES9028 dacs[2] = {ES9028("Left Channel", ES9028::MonoLeft, 0x48), ES9028("Right Channel", ES9028::MonoRight, 0x49)};
+DACControl dacCtrl(dacs, 2);
+DACControlTask task(dacCtrl);
+DACControlTask::Event events[64];
+unsigned int eventCount = 0;
+
+// polls the task, moving the clock on 10ms per poll, until an event of type (and value, unless -1) arrives or maxPolls
+// have passed. Returns the event's position in events[], -1 on timeout
+static int waitFor(DACControlTask::EventType type, int value = -1, unsigned int maxPolls = 2000)
+{
+  for (unsigned int i = 0; i < maxPolls; i++)
+  {
+    DACControlTask::Event event;
+    while (task.pollEvent(event))
+    {
+      if (eventCount == sizeof(events) / sizeof(events[0]))
+        return -1;
+      events[eventCount++] = event;
+      if ((event.type == type) && ((value < 0) || (event.value == value)))
+        return eventCount - 1;
+    }
+    hostAdvance(10);
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  return -1;
+}
+
+static unsigned int countEvents(DACControlTask::EventType type, unsigned int from)
+{
+  unsigned int count = 0;
+  for (unsigned int i = from; i < eventCount; i++)
+  {
+    if (events[i].type == type)
+      count++;
+  }
+  return count;
+}
+
+static void testTask()
+{
+  for (byte addr = 0x48; addr <= 0x49; addr++)
+  {
+    Wire.attach(addr);
+    Wire.registers(addr)[64] = 0xA1;                // ES9028PRO chip ID, locked
+  }
+  dacCtrl.begin();
+  CHECK(task.begin(1));
+
+  // an attenuation sent before power on is held until the DACs are initialised, and only reported once written
+  task.setAttenuation(30);
+  CHECK(waitFor(DACControlTask::Event_AttenuationApplied, -1, 20) < 0);
+  CHECK(task.powerOn());
+  int initialised = waitFor(DACControlTask::Event_Initialised);
+  CHECK(initialised >= 0);
+  int applied = waitFor(DACControlTask::Event_AttenuationApplied, 30);
+  CHECK(applied > initialised);
+  CHECK(countEvents(DACControlTask::Event_AttenuationApplied, 0) == 1);
+
+  // a burst sent while the task is not running is applied as a single write of the last value
+  task.end();
+  unsigned int burstStart = eventCount;
+  for (byte val = 31; val <= 90; val++)
+    task.setAttenuation(val);
+  CHECK(task.begin(1));
+  CHECK(waitFor(DACControlTask::Event_AttenuationApplied, 90) >= 0);
+  waitFor(DACControlTask::Event_InputSwitched, -1, 20);   // lets any stray events arrive
+  task.end();
+  CHECK(countEvents(DACControlTask::Event_AttenuationApplied, burstStart) == 1);
+  CHECK(task.getCoalesced() == 59);
+  CHECK(dacCtrl.getCoalescedVolumes() == 0);
+  CHECK(dacCtrl.getAttenuation() == 90);
+  CHECK(task.getDroppedEvents() == 0);
+}
+
+int main()
+{
+  testQueue();
+  testLatest();
+  testTask();
+  return hostTestResult("DACControlTaskTest");
+}
+
+#else
+
+int main()
+{
+  printf("DACControlTaskTest: skipped, DACCONTROLTASK_STD_THREAD is not defined\n");
+  return 0;
+}
+
+#endif
@@ -0,0 +1,118 @@
+/*
+  DACControl driving ES9028s on the simulated I2C bus, run from a single thread with the host clock moved on by hand.
+*/
+
+#include "host/HostTest.h"
+#include <Wire.h>
+#include <DACControl.h>
+#include <math.h>
+
+static byte recoveries = 0;
+
+static bool configDAC(ES9028 *dac)
+{
+  return dac->setFilterShape(ES9028::Filter_Hybrid);
+}
+
+static void dacRecovered(byte, unsigned long)
+{
+  recoveries++;
+}
+
+static void runLoops(DACControl &dacCtrl, unsigned int count)
+{
+  for (unsigned int i = 0; i < count; i++)
+  {
+    dacCtrl.loop();
+    hostAdvance(10);
+  }
+}
+
+static void testRecoverMode()
+{
+  // a mono DAC that loses its registers gets its channel mapping back, not just the configuration callback's settings
+  Wire.attach(0x48);
+  Wire.attach(0x4A);
+  Wire.registers(0x48)[64] = 0xA1;                  // ES9028PRO chip ID, locked
+  Wire.registers(0x4A)[64] = 0xA1;
+  ES9028 defaults("Defaults", ES9028::EightChannel, 0x4A);
+  CHECK(defaults.initialise());                     // 0x4A holds the mapping a DAC has after a reset
+
+  ES9028 dacs[1] = {ES9028("Left Channel", ES9028::MonoLeft, 0x48)};
+  DACControl dacCtrl(dacs, 1);
+  dacCtrl.initES9028(configDAC);
+  dacCtrl.onDACRecovered(dacRecovered);
+  dacCtrl.begin();
+  dacCtrl.powerOn();
+  for (unsigned int i = 0; (i < 1000) && !dacCtrl.initialised(); i++)
+    runLoops(dacCtrl, 1);
+  CHECK(dacCtrl.initialised() && !dacCtrl.errorInitialising());
+  byte mapping[4];
+  memcpy(mapping, Wire.registers(0x48) + 38, sizeof(mapping));
+  CHECK(memcmp(mapping, Wire.registers(0x4A) + 38, sizeof(mapping)) != 0);
+
+  memcpy(Wire.registers(0x48), Wire.registers(0x4A), 64);   // brownout reset
+  runLoops(dacCtrl, 300);
+  CHECK(recoveries == 1);
+  CHECK(memcmp(mapping, Wire.registers(0x48) + 38, sizeof(mapping)) == 0);
+  runLoops(dacCtrl, 300);
+  CHECK(recoveries == 1);                           // the shadow was learned from the restored registers
+}
+
+static double quietest;                            // attenuation in dB, watched between setFineAttenuation() calls
+static double loudest;
+
+// attenuation of the DAC at 0x48 from its channel 1 volume and master trim registers
+static double attenuation()
+{
+  uint8_t *regs = Wire.registers(0x48);
+  unsigned long trim = regs[24] | ((unsigned long) regs[25] << 8) | ((unsigned long) regs[26] << 16) | ((unsigned long) regs[27] << 24);
+  if (trim == 0)
+    return 1000;
+  return regs[16] * 0.5 - 20 * log10(trim / (double) 0x7FFFFFFF);
+}
+
+static void watchLevel(uint8_t address)
+{
+  if (address != 0x48)
+    return;
+  double val = attenuation();
+  if (val > quietest)
+    quietest = val;
+  if (val < loudest)
+    loudest = val;
+}
+
+static void testFineAttenuationOrder()
+{
+  // stepping 0.05dB at a time across the 0.5dB boundaries in both directions never gets louder than either end
+  ES9028 dacs[1] = {ES9028("Left Channel", ES9028::MonoLeft, 0x48)};
+  DACControl dacCtrl(dacs, 1);
+  dacCtrl.begin();
+  dacCtrl.powerOn();
+  for (unsigned int i = 0; (i < 1000) && !dacCtrl.initialised(); i++)
+    runLoops(dacCtrl, 1);
+  CHECK(dacCtrl.initialised() && !dacCtrl.errorInitialising());
+  dacCtrl.setFineAttenuation(0);
+  Wire.onTransmission(watchLevel);
+  unsigned int from = 0;
+  for (int i = 1; i <= 60; i++)
+  {
+    unsigned int to = (i <= 30) ? i : 60 - i;
+    quietest = 0;
+    loudest = 1000;
+    dacCtrl.setFineAttenuation(to);
+    CHECK(fabs(attenuation() - to * 0.05) < 0.01);
+    CHECK(loudest > ((from < to) ? from : to) * 0.05 - 0.01);
+    CHECK(quietest < 0.5 + ((from > to) ? from : to) * 0.05 + 0.01);
+    from = to;
+  }
+  Wire.onTransmission(NULL);
+}
+
+int main()
+{
+  testRecoverMode();
+  testFineAttenuationOrder();
+  return hostTestResult("DACControlTest");
+}
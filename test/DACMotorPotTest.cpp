@@ -0,0 +1,118 @@
+/*
+  DACMotorPot against a simulated motor and pot: the motor accelerates towards its top speed while driven
+  and coasts to a halt when it is not. The pot is read every 5ms as a whole number of ADC counts.
+*/
+
+#include "host/HostTest.h"
+#include <DACMotorPot.h>
+
+struct SimulatedPot
+{
+  double position = 0;              // ADC counts
+  double speed = 0;                 // counts per ms
+  double topSpeed = 1.0;
+  double accel = 0.05;              // counts per ms per ms while driven
+  double friction = 0.05;           // counts per ms per ms while coasting
+  bool blocked = false;
+
+  void step(DACMotorPot::Drive drive)  // advance 1ms
+  {
+    if (blocked)
+    {
+      speed = 0;
+      return;
+    }
+    if (drive != DACMotorPot::Drive_Stop)
+    {
+      speed += drive * accel;
+      if (speed > topSpeed)
+        speed = topSpeed;
+      if (speed < -topSpeed)
+        speed = -topSpeed;
+    }
+    else if (speed > 0)
+      speed = (speed > friction) ? speed - friction : 0;
+    else
+      speed = (speed < -friction) ? speed + friction : 0;
+    position += speed;
+    if (position < 0)
+      position = 0;
+    if (position > 1023)
+      position = 1023;
+  }
+
+  int reading() { return (int) (position + 0.5); }
+};
+
+// runs a seek until it ends or maxTime ms have passed, returns the furthest reading past the target
+static int runSeek(DACMotorPot &motor, SimulatedPot &pot, int target, unsigned long maxTime)
+{
+  unsigned long now = 1000;
+  int overshoot = 0;
+  bool up = target > pot.reading();
+  DACMotorPot::Drive drive = DACMotorPot::Drive_Stop;
+  motor.seek(target, now);
+  for (unsigned long t = 0; t < maxTime; t++, now++)
+  {
+    if (t % 5 == 0)
+    {
+      drive = motor.update(pot.reading(), now);
+      DACMotorPot::State state = motor.getState();
+      if ((state != DACMotorPot::Motor_Seeking) && (state != DACMotorPot::Motor_Settling))
+        break;
+    }
+    pot.step(drive);
+    int past = up ? pot.reading() - target : target - pot.reading();
+    if (past > overshoot)
+      overshoot = past;
+  }
+  return overshoot;
+}
+
+static void testSettles()
+{
+  const int targets[] = {700, 180, 185, 900, 20, 512};
+  SimulatedPot pot;
+  pot.position = 100;
+  DACMotorPot motor;
+  for (unsigned int i = 0; i < sizeof(targets) / sizeof(targets[0]); i++)
+  {
+    int overshoot = runSeek(motor, pot, targets[i], 10000);
+    CHECK(motor.getState() == DACMotorPot::Motor_Reached);
+    CHECK(abs(pot.reading() - targets[i]) <= 8);   // the deadband doubles at most once when a seek hunts back
+    CHECK(overshoot <= 4);
+    CHECK(motor.getSeekTime() < 5000);
+  }
+}
+
+static void testStall()
+{
+  SimulatedPot pot;
+  pot.position = 300;
+  pot.blocked = true;
+  DACMotorPot motor;
+  runSeek(motor, pot, 800, 10000);
+  CHECK(motor.getState() == DACMotorPot::Motor_Stalled);
+  CHECK(pot.reading() == 300);
+}
+
+static void testTimeout()
+{
+  // fast enough to never look stalled, too slow to get there in time
+  SimulatedPot pot;
+  pot.position = 0;
+  pot.topSpeed = 0.05;
+  DACMotorPot motor;
+  motor.setTimeout(2000);
+  runSeek(motor, pot, 1000, 10000);
+  CHECK(motor.getState() == DACMotorPot::Motor_Timeout);
+  CHECK(pot.reading() < 1000);
+}
+
+int main()
+{
+  testSettles();
+  testStall();
+  testTimeout();
+  return hostTestResult("DACMotorPotTest");
+}
@@ -0,0 +1,156 @@
+/*
+  Counts heap allocations while the libraries run: malloc, calloc, realloc and operator new are all counted from the
+  moment the chips are constructed, through power on and init, to a long run of DACControl::loop() with the volume,
+  balance, input, mute and log paths in use. The host String copies its text onto the heap as the Arduino one does,
+  so any String built inside the libraries is counted.
+*/
+
+#include "host/HostTest.h"
+#include <new>
+#include <Wire.h>
+#include <DACControl.h>
+
+extern "C" void *__libc_malloc(size_t size);
+extern "C" void *__libc_calloc(size_t count, size_t size);
+extern "C" void *__libc_realloc(void *ptr, size_t size);
+
+static bool counting = false;
+static unsigned long allocations = 0;
+
+extern "C" void *malloc(size_t size)
+{
+  if (counting)
+    allocations++;
+  return __libc_malloc(size);
+}
+
+extern "C" void *calloc(size_t count, size_t size)
+{
+  if (counting)
+    allocations++;
+  return __libc_calloc(count, size);
+}
+
+extern "C" void *realloc(void *ptr, size_t size)
+{
+  if (counting)
+    allocations++;
+  return __libc_realloc(ptr, size);
+}
+
+void *operator new(size_t size)
+{
+  if (counting)
+    allocations++;
+  void *ptr = __libc_malloc(size ? size : 1);
+  if (ptr == NULL)
+    throw std::bad_alloc();
+  return ptr;
+}
+
+void *operator new[](size_t size)
+{
+  return operator new(size);
+}
+
+// prints val through Msg and returns the number of characters written
+static unsigned long printed(unsigned long val, int base)
+{
+  unsigned long before = Serial.written();
+  Msg::print(val, base);
+  return Serial.written() - before;
+}
+
+static void runLoops(DACControl &dacCtrl, unsigned int count)
+{
+  for (unsigned int i = 0; i < count; i++)
+  {
+    dacCtrl.loop();
+    hostAdvance(10);
+  }
+}
+
+static void testCounted()
+{
+  // the counter itself sees a String being built
+  counting = true;
+  {
+    String name("Left Channel");
+  }
+  counting = false;
+  CHECK(allocations == 1);
+  allocations = 0;
+}
+
+static void testSteadyState()
+{
+  for (byte addr = 0x48; addr <= 0x49; addr++)
+  {
+    Wire.attach(addr);
+    Wire.registers(addr)[64] = 0xA1;                // ES9028PRO chip ID, locked
+  }
+
+  counting = true;
+  ES9028 dacs[2] = {ES9028(F("Left Channel"), ES9028::MonoLeft, 0x48), ES9028("Right Channel", ES9028::MonoRight, 0x49)};
+  DACControl dacCtrl(dacs, 2);
+  dacCtrl.begin();
+  dacCtrl.powerOn();
+  for (unsigned int i = 0; (i < 1000) && !dacCtrl.initialised(); i++)
+    runLoops(dacCtrl, 1);
+  CHECK(dacCtrl.initialised() && !dacCtrl.errorInitialising());
+  CHECK(allocations == 0);
+
+  unsigned long written = Serial.written();
+  for (unsigned int i = 0; i < 2000; i++)
+  {
+    switch (i % 100)
+    {
+      case 0:
+        dacCtrl.setAttenuation(i % 90);
+        break;
+      case 10:
+        dacCtrl.requestAttenuation(i % 80);
+        break;
+      case 20:
+        dacCtrl.setBalance((i % 7) - 3);
+        break;
+      case 30:
+        dacCtrl.selectInput((i % 200) ? DACControl::SPDIF : DACControl::I2S);
+        break;
+      case 50:
+        for (byte addr = 0x48; addr <= 0x49; addr++)
+          Wire.registers(addr)[64] ^= 1;            // lock lost or regained, which logs every DAC's name
+        break;
+      case 60:
+        dacCtrl.mute();
+        break;
+      case 70:
+        dacCtrl.unmute();
+        break;
+      case 80:
+        dacs[0].printName();
+        dacs[1].printName(Msg::W);
+        Msg::println(dacCtrl.getAttenuation(), HEX);
+        break;
+    }
+    runLoops(dacCtrl, 1);
+  }
+  counting = false;
+  CHECK(allocations == 0);
+  CHECK(Serial.written() > written);                // the log paths did run
+}
+
+static void testNumberBases()
+{
+  CHECK(printed(0xAB, HEX) == 2);
+  CHECK(printed(5, BIN) == 3);
+  CHECK(printed(255, DEC) == 3);
+}
+
+int main()
+{
+  testCounted();
+  testSteadyState();
+  testNumberBases();
+  return hostTestResult("HeapTest");
+}
@@ -0,0 +1,169 @@
+/*
+  Minimal Arduino core for the host tests: fake clock, inert pins and a Serial that formats into a counter
+  instead of a port. Only String allocates, as it does on the boards, so the heap test sees every String the libraries build.
+*/
+
+#ifndef Arduino_h
+#define Arduino_h
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <atomic>
+#include <chrono>
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+class __FlashStringHelper;
+#define F(s) (reinterpret_cast<const __FlashStringHelper *>(s))
+#define PSTR(s) (s)
+#define PROGMEM
+#define pgm_read_byte(p) (*(const uint8_t *)(p))
+#define pgm_read_word(p) (*(const uint16_t *)(p))
+#define pgm_read_dword(p) (*(const uint32_t *)(p))
+#define pgm_read_ptr(p) (*(void * const *)(p))
+#define strlen_P strlen
+#define memcpy_P memcpy
+
+#define HIGH 1
+#define LOW 0
+#define INPUT 0
+#define OUTPUT 1
+#define INPUT_PULLUP 2
+#define CHANGE 1
+#define FALLING 2
+#define RISING 3
+#define DEC 10
+#define HEX 16
+#define OCT 8
+#define BIN 2
+#define LED_BUILTIN 13
+#define bitRead(v, b) (((v) >> (b)) & 1)
+#define bitSet(v, b) ((v) |= (1UL << (b)))
+#define bitClear(v, b) ((v) &= ~(1UL << (b)))
+#define digitalPinToInterrupt(p) (p)
+
+#include "binary.h"
+
+// host clock: real time plus whatever the test skips ahead with hostAdvance()
+inline std::atomic<unsigned long> &hostOffset() { static std::atomic<unsigned long> offset(0); return offset; }
+inline unsigned long micros()
+{
+  static const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  return (unsigned long) std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count() + hostOffset() * 1000UL;
+}
+inline unsigned long millis() { return micros() / 1000; }
+inline void hostAdvance(unsigned long ms) { hostOffset() += ms; }
+inline void delay(unsigned long ms) { hostAdvance(ms); }
+inline void delayMicroseconds(unsigned int) {}
+inline void yield() {}
+
+inline int &hostAnalog() { static int val = 0; return val; }
+inline void pinMode(uint8_t, uint8_t) {}
+inline void digitalWrite(uint8_t, uint8_t) {}
+inline int digitalRead(uint8_t) { return LOW; }
+inline int analogRead(uint8_t) { return hostAnalog(); }
+inline void attachInterrupt(uint8_t, void (*)(), int) {}
+inline void noInterrupts() {}
+inline void interrupts() {}
+
+// keeps its own copy of the text on the heap like the Arduino String, so building or copying one is an allocation
+class String
+{
+  public:
+    String(const char *val = "") : _text(strdup(val)) {}
+    String(const __FlashStringHelper *val) : String((const char *) val) {}
+    String(const String &val) : String(val._text) {}
+    explicit String(int val, int base = DEC) : String((long) val, base) {}
+    explicit String(unsigned int val, int base = DEC) : String((unsigned long) val, base) {}
+    explicit String(long val, int base = DEC) : String(((val < 0) && (base == DEC)) ? _digits(-val, base, true) : _digits(val, base, false)) {}
+    explicit String(unsigned long val, int base = DEC) : String(_digits(val, base, false)) {}
+    ~String() { free(_text); }
+    String &operator=(const String &val)
+    {
+      if (this != &val)
+      {
+        free(_text);
+        _text = strdup(val._text);
+      }
+      return *this;
+    }
+    const char *c_str() const { return _text; }
+    unsigned int length() const { return strlen(_text); }
+
+  private:
+    char *_text;
+
+    static const char *_digits(unsigned long val, int base, bool negative)
+    {
+      static char buf[34];
+      byte i = sizeof(buf) - 1;
+      buf[i] = 0;
+      do
+      {
+        buf[--i] = "0123456789ABCDEF"[val % base];
+        val /= base;
+      } while (val != 0);
+      if (negative)
+        buf[--i] = '-';
+      return buf + i;
+    }
+};
+
+class Print
+{
+  public:
+    virtual ~Print() {}
+    virtual size_t write(uint8_t) { _written++; return 1; }
+    size_t write(const uint8_t *, size_t n) { _written += n; return n; }
+    size_t print(const char *val) { return _put("%s", val); }
+    size_t print(const __FlashStringHelper *val) { return print((const char *) val); }
+    size_t print(const String &val) { return print(val.c_str()); }
+    size_t print(char val) { return _put("%c", val); }
+    size_t print(unsigned char val, int base = DEC) { return print((unsigned long) val, base); }
+    size_t print(int val, int base = DEC) { return print((long) val, base); }
+    size_t print(unsigned int val, int base = DEC) { return print((unsigned long) val, base); }
+    size_t print(long val, int base = DEC) { return (base == DEC) ? _put("%ld", val) : print((unsigned long) val, base); }
+    size_t print(unsigned long val, int base = DEC)
+    {
+      char buf[33];
+      byte i = sizeof(buf) - 1;
+      buf[i] = 0;
+      do
+      {
+        buf[--i] = "0123456789ABCDEF"[val % base];
+        val /= base;
+      } while (val != 0);
+      return print(buf + i);
+    }
+    size_t print(double val, int digits = 2) { return _put("%.*f", digits, val); }
+    size_t println() { return print("\r\n"); }
+    template <typename T> size_t println(T val) { return print(val) + println(); }
+    template <typename T> size_t println(T val, int base) { return print(val, base) + println(); }
+    unsigned long written() { return _written; }  // characters printed so far
+
+  private:
+    unsigned long _written = 0;
+
+    template <typename... Args>
+    size_t _put(const char *format, Args... args)
+    {
+      char buf[64];
+      int n = snprintf(buf, sizeof(buf), format, args...);
+      _written += n;
+      return n;
+    }
+};
+
+class HardwareSerial : public Print
+{
+  public:
+    void begin(unsigned long) {}
+};
+extern HardwareSerial Serial;
+
+#endif
@@ -0,0 +1,18 @@
+// EEPROM held in RAM for the host tests
+#ifndef EEPROM_h
+#define EEPROM_h
+#include "Arduino.h"
+
+class EEPROMClass
+{
+  public:
+    void begin(size_t) {}
+    uint8_t read(int addr) { return _data[addr % sizeof(_data)]; }
+    void write(int addr, uint8_t val) { _data[addr % sizeof(_data)] = val; }
+    bool commit() { return true; }
+  private:
+    uint8_t _data[1024] = {};
+};
+extern EEPROMClass EEPROM;
+
+#endif
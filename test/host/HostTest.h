@@ -0,0 +1,19 @@
+// checks for the host tests: each failure is printed and main() returns hostTestResult()
+#ifndef HostTest_h
+#define HostTest_h
+#include <stdio.h>
+
+inline int &hostTestFailures() { static int failures = 0; return failures; }
+
+#define CHECK(cond) do { if (!(cond)) { printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); hostTestFailures()++; } } while (0)
+
+inline int hostTestResult(const char *name)
+{
+  if (hostTestFailures() == 0)
+    printf("%s: passed\n", name);
+  else
+    printf("%s: %d failed\n", name, hostTestFailures());
+  return hostTestFailures() == 0 ? 0 : 1;
+}
+
+#endif
@@ -0,0 +1,13 @@
+// SerialDebug stand-in for the host tests, every level prints to Serial
+#include "Arduino.h"
+
+#define printD(...) Serial.print(__VA_ARGS__)
+#define printI(...) Serial.print(__VA_ARGS__)
+#define printW(...) Serial.print(__VA_ARGS__)
+#define printE(...) Serial.print(__VA_ARGS__)
+#define printlnD(...) Serial.println(__VA_ARGS__)
+#define printlnI(...) Serial.println(__VA_ARGS__)
+#define printlnW(...) Serial.println(__VA_ARGS__)
+#define printlnE(...) Serial.println(__VA_ARGS__)
+#define debugHandle()
+inline void debugSetLevel(int) {}
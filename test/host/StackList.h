@@ -0,0 +1 @@
+// StackList stand-in for the host tests, DACControl includes it but does not use it
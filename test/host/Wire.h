@@ -0,0 +1,84 @@
+/*
+  I2C bus for the host tests. Each attached device is a bank of 256 auto-incrementing registers, which is how
+  the ES9028 and ES9018 behave on the bus. Register writes read back unchanged, so verified writes succeed.
+*/
+
+#ifndef TwoWire_h
+#define TwoWire_h
+#include "Arduino.h"
+
+class TwoWire
+{
+  public:
+    void begin() {}
+    void begin(uint8_t) {}
+    void begin(int, int) {}
+    void setClock(unsigned long) {}
+    void setClockStretchLimit(unsigned long) {}
+
+    void attach(uint8_t address) { _present[address & 0x7F] = true; }
+    void detach(uint8_t address) { _present[address & 0x7F] = false; }
+    uint8_t *registers(uint8_t address) { return _regs[address & 0x7F]; }
+    void onTransmission(void (*val)(uint8_t address)) { _onTransmission = val; }  // called after each write, to watch the order of register changes
+
+    void beginTransmission(uint8_t address)
+    {
+      _address = address & 0x7F;
+      _first = true;
+    }
+
+    size_t write(uint8_t val)
+    {
+      if (_first)
+        _pointer = val;
+      else
+        _regs[_address][_pointer++] = val;
+      _first = false;
+      return 1;
+    }
+
+    size_t write(const uint8_t *vals, size_t count)
+    {
+      for (size_t i = 0; i < count; i++)
+        write(vals[i]);
+      return count;
+    }
+
+    uint8_t endTransmission(bool = true)
+    {
+      if (!_present[_address])
+        return 2;
+      if (_onTransmission != NULL)
+        _onTransmission(_address);
+      return 0;
+    }
+
+    uint8_t requestFrom(int address, int count)
+    {
+      _address = address & 0x7F;
+      _available = _present[_address] ? count : 0;
+      return _available;
+    }
+
+    int available() { return _available; }
+
+    int read()
+    {
+      if (_available == 0)
+        return -1;
+      _available--;
+      return _regs[_address][_pointer++];
+    }
+
+  private:
+    bool _present[128] = {};
+    uint8_t _regs[128][256] = {};
+    uint8_t _address = 0;
+    uint8_t _pointer = 0;
+    uint8_t _available = 0;
+    bool _first = false;
+    void (*_onTransmission)(uint8_t address) = NULL;
+};
+extern TwoWire Wire;
+
+#endif
@@ -0,0 +1,17 @@
+// the binary constants used by the libraries
+#define B1 0b1
+#define B00000001 0b00000001
+#define B00000010 0b00000010
+#define B00000100 0b00000100
+#define B00001000 0b00001000
+#define B01111111 0b01111111
+#define B10000000 0b10000000
+#define B10001110 0b10001110
+#define B101000 0b101000
+#define B101001 0b101001
+#define B101010 0b101010
+#define B11100000 0b11100000
+#define B11100110 0b11100110
+#define B11111000 0b11111000
+#define B11111100 0b11111100
+#define B11111110 0b11111110
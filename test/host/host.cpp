@@ -0,0 +1,8 @@
+// objects the Arduino core defines, shared by every translation unit of a host test
+#include "Arduino.h"
+#include "Wire.h"
+#include "EEPROM.h"
+
+HardwareSerial Serial;
+TwoWire Wire;
+EEPROMClass EEPROM;
@@ -0,0 +1,27 @@
+#!/bin/sh
+# builds and runs the host tests with the system g++, e.g. sh test/run.sh
+cd "$(dirname "$0")/.." || exit 1
+OUT=${TMPDIR:-/tmp}/dac_host_tests
+mkdir -p "$OUT"
+# unused library code is dropped at link time, as in the Arduino builds
+CXX="${CXX:-g++} -std=gnu++11 -Wall -Wextra -DARDUINO=10805 -ffunction-sections -Wl,--gc-sections -Itest/host"
+for d in Global SerialHelper DACChip ES9018 ES9028 SampleRate DACControl DACVolumeControl; do CXX="$CXX -I$d"; done
+rc=0
+
+run()
+{
+  name=$1
+  shift
+  if $CXX -o "$OUT/$name" "test/$name.cpp" test/host/host.cpp "$@" -lpthread; then
+    "$OUT/$name" || rc=1
+  else
+    rc=1
+  fi
+}
+
+run DACMotorPotTest DACVolumeControl/DACMotorPot.cpp
+DACCONTROL="DACControl/DACConfigStore.cpp DACControl/DACControl.cpp DACControl/DACEvents.cpp DACControl/DACHistory.cpp DACControl/DACStatus.cpp ES9028/ES9028.cpp SampleRate/SampleRate.cpp SerialHelper/SerialHelper.cpp"
+run DACControlTaskTest -DDACCONTROLTASK_STD_THREAD DACControl/DACControlTask.cpp $DACCONTROL
+run HeapTest $DACCONTROL
+run DACControlTest $DACCONTROL
+exit $rc